@@ -49,6 +49,9 @@ static struct details {
   ENTRY(Double, double),
   ENTRY(Complex32, float complex),
   ENTRY(Complex64, double complex),
+  ENTRY(Long_as_int, long),
+  ENTRY(Llong_as_int, long long),
+  ENTRY(Size_t_as_int, size_t),
 };
 
 void generate_function(char *name, char *type,
@@ -7,55 +7,292 @@
 
 (* Cstubs public interface. *)
 
+type ('a, 'b) batch =
+    Batch_returns : 'a Ctypes.typ -> ('a, 'a Ctypes.carray -> unit) batch
+  | Batch_function : 'a Ctypes.typ * ('b, 'c) batch ->
+    ('a -> 'b, 'a Ctypes.carray -> 'c) batch
+
+let rec batch_fn : type a b. (a, b) batch -> a Ctypes.fn = function
+  | Batch_returns t -> Ctypes.returning t
+  | Batch_function (t, b) -> Ctypes.(t @-> batch_fn b)
+
+let batched b f =
+  let open Ctypes in
+  (* [n] is the length of the arrays, or -1 before the first array. *)
+  let check n a =
+    if n >= 0 && CArray.length a <> n then invalid_arg "Cstubs.batched"
+    else CArray.length a in
+  let rec loop : type a b. (a, b) batch -> int -> (int -> a) -> b =
+    fun b n f -> match b with
+    | Batch_returns _ -> fun out ->
+      for i = 0 to check n out - 1 do CArray.set out i (f i) done
+    | Batch_function (_, b) -> fun a ->
+      loop b (check n a) (fun i -> f i (CArray.get a i))
+  in loop b (-1) (fun _ -> f)
+
+type ('a, 'b) into =
+    Into_returns : 'a Ctypes.typ -> ('a, 'a Ctypes.ptr -> unit) into
+  | Into_function : 'a Ctypes.typ * ('b, 'c) into ->
+    ('a -> 'b, 'a -> 'c) into
+
+let rec into_fn : type a b. (a, b) into -> a Ctypes.fn = function
+  | Into_returns t -> Ctypes.returning t
+  | Into_function (t, i) -> Ctypes.(t @-> into_fn i)
+
+let rec storing : type a b. (a, b) into -> a -> b = fun i f -> match i with
+  | Into_returns _ -> fun p -> Ctypes.(p <-@ f)
+  | Into_function (_, i) -> fun x -> storing i (f x)
+
 module type FOREIGN =
 sig
   type 'a fn
   val foreign : string -> ('a -> 'b) Ctypes.fn -> ('a -> 'b) fn
 end
 
-module type FOREIGN' = FOREIGN with type 'a fn = unit
+module type FOREIGN_EXT =
+sig
+  include FOREIGN
+  val foreign_ext : ?noalloc:bool -> ?release_runtime_lock:bool ->
+    string -> ('a -> 'b) Ctypes.fn -> ('a -> 'b) fn
+  val foreign_batch : ?release_runtime_lock:bool ->
+    string -> ('a -> 'b, 'c) batch -> 'c fn
+  val foreign_into : string -> ('a -> 'b, 'c) into -> 'c fn
+  val funptr : ('a -> 'b) Ctypes.fn -> ('a -> 'b) Ctypes.typ
+end
+
+module type FOREIGN' = FOREIGN_EXT with type 'a fn = unit
 
 module type BINDINGS = functor (F : FOREIGN') -> sig end
 
+(* The number of trampolines generated for each function pointer type. *)
+let funptr_slots = 32
+
+let funptr_name prefix fn =
+  Printf.sprintf "%s_funptr_%s" prefix (Cstubs_internals.funptr_key fn)
+
+(* During generation function pointer types are used only for their
+   structure, and are never converted. *)
+let generated_funptr fn =
+  let unavailable _ = failwith "Cstubs: function pointer used during generation" in
+  Cstubs_internals.funptr_view fn ~read:unavailable ~write:unavailable
+
+(* Each function pointer type is generated once, however many times it
+   appears in the bindings. *)
+let once table key f =
+  if not (Hashtbl.mem table key) then begin
+    Hashtbl.add table key ();
+    f ()
+  end
+
+(* A function bound more than once with different options has a stub for
+   each combination of options. *)
+let stub_name prefix cname ~noalloc ~release_runtime_lock =
+  Printf.sprintf "%s%s%s%s" prefix cname
+    (if noalloc then "_noalloc" else "")
+    (if release_runtime_lock then "_unlocked" else "")
+
+let batch_stub_name prefix cname ~release_runtime_lock =
+  stub_name prefix cname ~noalloc:false ~release_runtime_lock ^ "_batch"
+
+(* Stubs for [foreign_into] are generated only for struct and union results,
+   which the stubs already store through a pointer. *)
+let into_stub_name prefix cname fn =
+  if Cstubs_analysis.returns_structured fn then prefix ^ cname ^ "_into"
+  else raise (Ctypes.Unsupported
+                "foreign_into requires a struct or union result")
+
 let gen_c prefix fmt : (module FOREIGN') =
+  let funptrs = Hashtbl.create 8 in
   (module
    struct
      type 'a fn = unit
-     let foreign cname fn =
-       Cstubs_generate_c.fn ~cname ~stub_name:(prefix ^ cname) fmt fn
+     let foreign_ext ?(noalloc=false) ?(release_runtime_lock=false) cname fn =
+       Cstubs_generate_c.fn ~cname
+         ~stub_name:(stub_name prefix cname ~noalloc ~release_runtime_lock)
+         ~release_runtime_lock fmt fn
+     let foreign cname fn = foreign_ext cname fn
+     let foreign_batch ?(release_runtime_lock=false) cname b =
+       Cstubs_generate_c.batch ~cname
+         ~stub_name:(batch_stub_name prefix cname ~release_runtime_lock)
+         ~release_runtime_lock fmt (batch_fn b)
+     let foreign_into cname i =
+       let fn = into_fn i in
+       Cstubs_generate_c.fn ~cname ~stub_name:(into_stub_name prefix cname fn)
+         ~release_runtime_lock:false fmt fn
+     let funptr fn =
+       let name = funptr_name prefix fn in
+       once funptrs name (fun () ->
+         Cstubs_generate_c.funptr ~name ~slots:funptr_slots fmt fn;
+         foreign (name ^ "_call") Ctypes.(ptr void @-> fn));
+       generated_funptr fn
    end)
 
-type bind = Bind : string * string * ('a -> 'b) Ctypes.fn -> bind
+type bind =
+  Bind : string * string * bool * bool * ('a -> 'b) Ctypes.fn -> bind
+type batch_bind =
+  Batch_bind : string * string * bool * ('a -> 'b) Ctypes.fn -> batch_bind
+type into_bind = Into_bind : string * string * ('a -> 'b) Ctypes.fn -> into_bind
+(* A function pointer type: the key, the name of its C functions and the
+   name of the external that returns the addresses of its trampolines *)
+type funptr_bind = Funptr_bind of string * string * string
 
-let write_foreign fmt bindings =
+let write_indexes fmt table_name print_key names =
+  let count = List.length names in
+  Format.fprintf fmt
+    "@[<v 2>let %s =@ " table_name;
+  Format.fprintf fmt
+    "let table = Hashtbl.create %d in@ " count;
+  Format.fprintf fmt
+    "@[<hov 2>List.iter@ (fun (name, index) -> Hashtbl.add table name index)@ [";
+  (* Hashtbl.find_all returns the most recently added binding first. *)
+  ListLabels.iteri (List.rev names)
+    ~f:(fun i name ->
+      Format.fprintf fmt "@[(%a,@ %d)@];@ " print_key name (count - 1 - i));
+  Format.fprintf fmt "]@];@ Hashtbl.find_all table@]@\n@\n"
+
+(* Each binding is numbered, and [foreign_ext] finds the numbers of the bindings
+   for a name and set of options in a table built once, then matches the
+   number and the type together.  A match on integers compiles to a jump
+   table, so binding [n] functions takes time linear in [n]. *)
+let write_foreign fmt bindings batch_bindings into_bindings funptr_bindings =
   Format.fprintf fmt
     "type 'a fn = 'a@\n@\n";
+  write_indexes fmt "foreign_indexes"
+    (fun fmt (cname, noalloc, release_runtime_lock) ->
+      Format.fprintf fmt "(%S,@ %B,@ %B)" cname noalloc release_runtime_lock)
+    (List.map (fun (Bind (cname, _, noalloc, release_runtime_lock, _)) ->
+      (cname, noalloc, release_runtime_lock)) bindings);
+  Format.fprintf fmt
+    "let foreign_ext : type a b. ?noalloc:bool -> ?release_runtime_lock:bool ->@\n";
+  Format.fprintf fmt
+    "  string -> (a -> b) Ctypes.fn -> (a -> b) =@\n";
+  Format.fprintf fmt
+    "  fun ?(noalloc=false) ?(release_runtime_lock=false) name t ->@\n";
+  Format.fprintf fmt
+    "  let rec find : int list -> (a -> b) = function@\n";
+  Format.fprintf fmt
+    "    | [] -> Printf.fprintf stderr \"No match for %%s\" name; assert false@\n";
+  Format.fprintf fmt
+    "    | index :: indexes -> match index, t with@\n@[<v>";
+  ListLabels.iteri bindings
+    ~f:(fun index (Bind (_, external_name, _, release_runtime_lock, fn)) ->
+      Cstubs_generate_ml.case ~index ~external_name ~release_runtime_lock
+        fmt fn);
+  Format.fprintf fmt "| _ -> find indexes@]@\n";
+  Format.fprintf fmt
+    "  in find (foreign_indexes (name, noalloc, release_runtime_lock))@\n@\n";
+  Format.fprintf fmt "let foreign name t = foreign_ext name t@\n@\n";
+  write_indexes fmt "foreign_batch_indexes"
+    (fun fmt (cname, release_runtime_lock) ->
+      Format.fprintf fmt "(%S,@ %B)" cname release_runtime_lock)
+    (List.map (fun (Batch_bind (cname, _, release_runtime_lock, _)) ->
+      (cname, release_runtime_lock)) batch_bindings);
+  Format.fprintf fmt
+    "let foreign_batch : type a b c. ?release_runtime_lock:bool ->@\n";
+  Format.fprintf fmt
+    "  string -> (a -> b, c) Cstubs.batch -> c =@\n";
+  Format.fprintf fmt
+    "  fun ?(release_runtime_lock=false) name t ->@\n";
+  Format.fprintf fmt
+    "  let rec find : int list -> c = function@\n";
+  Format.fprintf fmt
+    "    | [] -> Printf.fprintf stderr \"No match for %%s\" name; assert false@\n";
+  Format.fprintf fmt
+    "    | index :: indexes -> match index, t with@\n@[<v>";
+  ListLabels.iteri batch_bindings
+    ~f:(fun index (Batch_bind (_, external_name, _, fn)) ->
+      Cstubs_generate_ml.batch_case ~index ~external_name fmt fn);
+  Format.fprintf fmt "| _ -> find indexes@]@\n";
+  Format.fprintf fmt
+    "  in find (foreign_batch_indexes (name, release_runtime_lock))@\n@\n";
+  write_indexes fmt "foreign_into_indexes"
+    (fun fmt cname -> Format.fprintf fmt "%S" cname)
+    (List.map (fun (Into_bind (cname, _, _)) -> cname) into_bindings);
+  Format.fprintf fmt
+    "let foreign_into : type a b c.@\n";
+  Format.fprintf fmt
+    "  string -> (a -> b, c) Cstubs.into -> c =@\n";
+  Format.fprintf fmt
+    "  fun name t ->@\n";
+  Format.fprintf fmt
+    "  let rec find : int list -> c = function@\n";
+  Format.fprintf fmt
+    "    | [] -> Printf.fprintf stderr \"No match for %%s\" name; assert false@\n";
+  Format.fprintf fmt
+    "    | index :: indexes -> match index, t with@\n@[<v>";
+  ListLabels.iteri into_bindings
+    ~f:(fun index (Into_bind (_, external_name, fn)) ->
+      Cstubs_generate_ml.into_case ~index ~external_name fmt fn);
+  Format.fprintf fmt "| _ -> find indexes@]@\n";
+  Format.fprintf fmt "  in find (foreign_into_indexes name)@\n@\n";
+  ListLabels.iteri funptr_bindings
+    ~f:(fun i (Funptr_bind (_, name, slot_address)) ->
+      Format.fprintf fmt
+        "@[<hov 2>let funptr_pool_%d =@ CI.funptr_pool@ ~name:%S@ ~slots:%d@ ~slot_address:%s@]@\n@\n"
+        i name funptr_slots slot_address);
+  Format.fprintf fmt
+    "let funptr : type a b. (a -> b) Ctypes.fn -> (a -> b) Ctypes.typ =@\n";
   Format.fprintf fmt
-    "let foreign : type a b. string -> (a -> b) Ctypes.fn -> (a -> b) =@\n";
+    "  fun fn -> match CI.funptr_key fn with@\n@[<v>";
+  ListLabels.iteri funptr_bindings
+    ~f:(fun i (Funptr_bind (key, name, _)) ->
+      Format.fprintf fmt
+        "@[<hov 2>| %S ->@ CI.make_funptr funptr_pool_%d fn@ (foreign %S Ctypes.(ptr void @@-> fn))@]@ "
+        key i (name ^ "_call"));
   Format.fprintf fmt
-    "  fun name t -> match name, t with@\n@[<v>";
-  ListLabels.iter bindings
-    ~f:(fun (Bind (stub_name, external_name, fn)) ->
-      Cstubs_generate_ml.case ~stub_name ~external_name fmt fn);
-  Format.fprintf fmt "@[<hov 2>@[|@ s,@ _@ ->@]@ ";
-  Format.fprintf fmt " @[@[Printf.fprintf@ stderr@ \"No match for %%s\" s@];";
-  Format.fprintf fmt "@ @[assert false@]@]@]@]@."
+    "| key -> Printf.fprintf stderr \"No trampolines for %%s\" key; assert false@]@."
 
 let gen_ml prefix fmt : (module FOREIGN') * (unit -> unit) =
   let bindings = ref []
+  and batch_bindings = ref []
+  and into_bindings = ref []
+  and funptr_bindings = ref []
   and counter = ref 0 in
   let var prefix name = incr counter;
     Printf.sprintf "%s_%d_%s" prefix !counter name in
   (module
    struct
      type 'a fn = unit
-     let foreign cname fn =
-       let external_name = var prefix cname 
-       and stub_name = prefix ^ cname in
-       bindings := Bind (cname, external_name, fn) :: !bindings;
-       Cstubs_generate_ml.extern ~stub_name ~external_name fmt fn
+     let foreign_ext ?(noalloc=false) ?(release_runtime_lock=false) cname fn =
+       let external_name = var prefix cname
+       and stub_name = stub_name prefix cname ~noalloc ~release_runtime_lock in
+       bindings :=
+         Bind (cname, external_name, noalloc, release_runtime_lock, fn)
+         :: !bindings;
+       Cstubs_generate_ml.extern ~stub_name ~external_name ~noalloc
+         ~release_runtime_lock fmt fn
+     let foreign cname fn = foreign_ext cname fn
+     let foreign_batch ?(release_runtime_lock=false) cname b =
+       let external_name = var prefix (cname ^ "_batch")
+       and stub_name = batch_stub_name prefix cname ~release_runtime_lock in
+       batch_bindings :=
+         Batch_bind (cname, external_name, release_runtime_lock, batch_fn b)
+         :: !batch_bindings;
+       Cstubs_generate_ml.batch_extern ~stub_name ~external_name fmt
+         (batch_fn b)
+     let foreign_into cname i =
+       let fn = into_fn i in
+       let external_name = var prefix (cname ^ "_into")
+       and stub_name = into_stub_name prefix cname fn in
+       into_bindings := Into_bind (cname, external_name, fn) :: !into_bindings;
+       Cstubs_generate_ml.extern ~stub_name ~external_name ~noalloc:false
+         ~release_runtime_lock:false fmt fn
+     let funptr fn =
+       let key = Cstubs_internals.funptr_key fn in
+       let name = funptr_name prefix fn in
+       if not (List.exists (fun (Funptr_bind (k, _, _)) -> k = key)
+                 !funptr_bindings) then begin
+         let slot_address = var prefix "funptr_slot" in
+         foreign (name ^ "_call") Ctypes.(ptr void @-> fn);
+         Format.fprintf fmt "@[<hov 2>external %s@ : int -> CI.voidp@ = %S@]@."
+           slot_address (name ^ "_slot");
+         funptr_bindings :=
+           Funptr_bind (key, name, slot_address) :: !funptr_bindings
+       end;
+       generated_funptr fn
    end),
-  fun () -> write_foreign fmt !bindings
+  fun () ->
+    write_foreign fmt !bindings !batch_bindings !into_bindings !funptr_bindings
 
 let write_c fmt ~prefix (module B : BINDINGS) =
   let module M = B((val gen_c prefix fmt)) in ()
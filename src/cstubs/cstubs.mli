@@ -7,13 +7,126 @@
 
 (* Cstubs public interface. *)
 
+type ('a, 'b) batch =
+    Batch_returns : 'a Ctypes.typ -> ('a, 'a Ctypes.carray -> unit) batch
+  | Batch_function : 'a Ctypes.typ * ('b, 'c) batch ->
+    ('a -> 'b, 'a Ctypes.carray -> 'c) batch
+(** A value of type [(f, g) batch] describes a C function of OCaml type [f]
+    together with its batched form [g], which takes an array for each
+    argument and an array for the results.  For example,
+
+    [Batch_function (double, Batch_returns double)]
+
+    describes a function of type [float -> float] whose batched form has type
+    [float carray -> float carray -> unit]. *)
+
+val batch_fn : ('a, 'b) batch -> 'a Ctypes.fn
+(** [batch_fn b] is the type of the C function described by [b]. *)
+
+val batched : ('a, 'b) batch -> 'a -> 'b
+(** [batched b f] is the batched form of [f], which applies [f] to the
+    corresponding elements of the argument arrays and stores the results in
+    the result array.
+
+    @raise Invalid_argument if the arrays have different lengths. *)
+
+type ('a, 'b) into =
+    Into_returns : 'a Ctypes.typ -> ('a, 'a Ctypes.ptr -> unit) into
+  | Into_function : 'a Ctypes.typ * ('b, 'c) into ->
+    ('a -> 'b, 'a -> 'c) into
+(** A value of type [(f, g) into] describes a C function of OCaml type [f]
+    together with a form [g] that takes, after the arguments, a pointer to
+    the memory that receives the result.  For example,
+
+    [Into_function (int, Into_function (int, Into_returns div_t))]
+
+    describes a function of type [int -> int -> div_t structure] whose form
+    [g] has type [int -> int -> div_t structure ptr -> unit]. *)
+
+val into_fn : ('a, 'b) into -> 'a Ctypes.fn
+(** [into_fn i] is the type of the C function described by [i]. *)
+
+val storing : ('a, 'b) into -> 'a -> 'b
+(** [storing i f] is the form of [f] that stores its result through the
+    pointer passed as its final argument. *)
+
 module type FOREIGN =
 sig
   type 'a fn
   val foreign : string -> ('a -> 'b) Ctypes.fn -> ('a -> 'b) fn
 end
 
-module type BINDINGS = functor (F : FOREIGN with type 'a fn = unit) -> sig end
+module type FOREIGN_EXT =
+sig
+  include FOREIGN
+
+  val foreign_ext : ?noalloc:bool -> ?release_runtime_lock:bool ->
+    string -> ('a -> 'b) Ctypes.fn -> ('a -> 'b) fn
+  (** [foreign_ext name typ] binds the C function [name] of type [typ], like
+      [foreign name typ], with additional control over the generated stub.
+
+      The argument [?noalloc], which defaults to [false], asserts that the C
+      function never calls back into OCaml.  If the generated stub neither
+      allocates on the OCaml heap nor raises exceptions then the binding is
+      generated as a ["noalloc"] external, which avoids saving and restoring
+      the runtime state on each call.  It is an error to pass [~noalloc:true]
+      for a function that calls back into OCaml, directly or indirectly.
+
+      The argument [?release_runtime_lock], which defaults to [false],
+      indicates that the generated stub should release the OCaml runtime
+      lock while the C function runs, so that other threads can run OCaml
+      code in the meantime.  The arguments are converted to C values before
+      the lock is released, and the memory referenced by pointer arguments
+      is kept alive until the call returns.  The C function must not access
+      the OCaml heap or call back into OCaml. *)
+
+  val foreign_batch : ?release_runtime_lock:bool ->
+    string -> ('a -> 'b, 'c) batch -> 'c fn
+  (** [foreign_batch name b] binds the batched form of the C function [name]
+      described by [b].  The generated stub loops over the arrays in C, so
+      the C compiler can inline and vectorise the calls.  The argument
+      [?release_runtime_lock] is as for {!foreign_ext}.
+
+      The batched function raises [Invalid_argument] if the arrays have
+      different lengths. *)
+
+  val foreign_into : string -> ('a -> 'b, 'c) into -> 'c fn
+  (** [foreign_into name i] binds the C function [name] described by [i],
+      whose struct or union result is written to the memory addressed by
+      the final argument.  Generated stubs for functions that return
+      structs or unions otherwise allocate a new value with malloc on each
+      call; a loop that calls a function bound with [foreign_into] can
+      instead reuse a single value:
+
+      {[let r = make div_t in
+for i = 1 to n do div_into i 3 (addr r); ... done]}
+
+      [Ctypes.Unsupported] is raised during generation if the result type
+      is not a struct or union. *)
+
+  val funptr : ('a -> 'b) Ctypes.fn -> ('a -> 'b) Ctypes.typ
+  (** [funptr typ] is a function pointer type for C functions of type
+      [typ], for use in the types of the bound functions.
+
+      In the generated bindings, OCaml functions are passed to C through a
+      fixed pool of statically generated C trampolines for each function
+      type, so no code is created at run time.  As with {!Foreign.funptr},
+      a function passed to C must be kept alive by the caller for as long
+      as C may call it.  Once a function has been collected its trampoline
+      may be reused for another function of the same type, and a pointer
+      that C kept from the earlier call then calls the new function; only
+      a trampoline that has not been reused raises
+      [Foreign.CallToExpiredClosure].  [Failure] is raised if all the
+      trampolines for a type hold live functions. *)
+end
+(** The extensions to {!FOREIGN} supported by generated stubs.  Every
+    module that matches [FOREIGN_EXT] also matches {!FOREIGN}, so bindings
+    written against {!FOREIGN} can be used unchanged. *)
+
+module type BINDINGS =
+  functor (F : FOREIGN_EXT with type 'a fn = unit) -> sig end
+(** Bindings are functors over {!FOREIGN_EXT}.  Functors over {!FOREIGN}
+    also have this type. *)
 
 val write_c : Format.formatter -> prefix:string -> (module BINDINGS) -> unit
 (** [write_c fmt ~prefix bindings] generates C stubs for the functions bound
@@ -27,7 +140,7 @@ val write_c : Format.formatter -> prefix:string -> (module BINDINGS) -> unit
 val write_ml : Format.formatter -> prefix:string -> (module BINDINGS) -> unit
 (** [write_ml fmt ~prefix bindings] generates ML bindings for the functions
     bound with [foreign] in [bindings].  The generated code conforms to the
-    {!FOREIGN} interface.
+    {!FOREIGN_EXT} interface, and so to the {!FOREIGN} interface.
 
     The generated code uses definitions exposed in the module
     [Cstubs_internals]. *)
@@ -19,6 +19,48 @@ let rec float : type a. a fn -> bool = function
   | Returns t -> is_float_primitive t
   | Function (f, t) -> is_float_primitive f && float t
 
+(* The representations in which a native stub can receive an argument or
+   return a result without boxing. *)
+type unboxed_repr = Unboxed_float | Untagged_int | Unboxed_int64
+
+let rec unboxed_repr : type a. a typ -> unboxed_repr option =
+  let open Primitives in function
+  | Primitive (Float | Double) -> Some Unboxed_float
+  | Primitive (Schar | Short | Int | Int8_t | Int16_t | Camlint) ->
+    Some Untagged_int
+  | Primitive Int64_t -> Some Unboxed_int64
+  | View { ty } -> unboxed_repr ty
+  | _ -> None
+
+let rec is_pointer : type a. a typ -> bool = function
+  | Pointer _ -> true
+  | View { ty } -> is_pointer ty
+  | _ -> false
+
+let rec is_structured : type a. a typ -> bool = function
+  | Struct _ -> true
+  | Union _ -> true
+  | View { ty } -> is_structured ty
+  | _ -> false
+
+let rec returns_structured : type a. a fn -> bool = function
+  | Returns t -> is_structured t
+  | Function (_, t) -> returns_structured t
+
+let rec unboxable : type a. a fn -> bool = function
+  | Returns t -> unboxed_repr t <> None
+  | Function (f, t) -> unboxed_repr f <> None || unboxable t
+
+(* The [@unboxed] and [@untagged] attributes on externals were introduced in
+   OCaml 4.03.  Earlier compilers support only the "float" attribute, which
+   applies when every argument and the result are floats. *)
+let unboxed_attributes =
+  Scanf.sscanf Sys.ocaml_version "%d.%d"
+    (fun major minor -> (major, minor) >= (4, 3))
+
+let native_unboxed fn =
+  if unboxed_attributes then unboxable fn else float fn
+
 (* A value of type 'a noalloc says that reading a value of type 'a
    will not cause an OCaml allocation in C code. *)
 type _ noalloc =
@@ -26,6 +68,12 @@ type _ noalloc =
 | Noalloc_int : int noalloc
 | Noalloc_char : char noalloc
 | Noalloc_bool : bool noalloc
+| Noalloc_uchar : Unsigned.uchar noalloc
+| Noalloc_uint8_t : Unsigned.uint8 noalloc
+| Noalloc_uint16_t : Unsigned.uint16 noalloc
+(* Structured results are written to memory that the OCaml wrapper
+   allocates before the call, so the stub itself does not allocate. *)
+| Noalloc_structured : (_, _) structured noalloc
 | Noalloc_view : ('a, 'b) view * 'b noalloc -> 'a noalloc
 
 (* A value of type 'a alloc says that reading a value of type 'a
@@ -34,22 +82,21 @@ type _ alloc =
 | Alloc_long : Signed.long alloc
 | Alloc_llong : Signed.llong alloc
 | Alloc_uint : Unsigned.uint alloc
-| Alloc_uchar : Unsigned.uchar alloc
 | Alloc_ushort : Unsigned.ushort alloc
 | Alloc_ulong : Unsigned.ulong alloc
 | Alloc_ullong : Unsigned.ullong alloc
 | Alloc_size_t : Unsigned.size_t alloc
 | Alloc_int32_t : int32 alloc
 | Alloc_int64_t : int64 alloc
-| Alloc_uint8_t : Unsigned.uint8 alloc
-| Alloc_uint16_t : Unsigned.uint16 alloc
 | Alloc_uint32_t : Unsigned.uint32 alloc
 | Alloc_uint64_t : Unsigned.uint64 alloc
 | Alloc_nativeint : nativeint alloc
+(* Conversions to int that raise an exception if the value is out of range *)
+| Alloc_checked_int : int alloc
 | Alloc_float : float alloc
 | Alloc_complex : Complex.t alloc
 | Alloc_pointer : _ ptr alloc
-| Alloc_structured : (_, _) structured alloc
+| Alloc_abstract : _ abstract alloc
 | Alloc_array : _ carray alloc
 | Alloc_bigarray : (_, 'a) Ctypes_bigarray.t -> 'a alloc
 | Alloc_view : ('a, 'b) view * 'b alloc -> 'a alloc
@@ -68,15 +115,15 @@ let primitive_allocation : type a. a Primitives.prim -> a allocation =
  | Long -> `Alloc Alloc_long
  | Llong -> `Alloc Alloc_llong
  | Ushort -> `Alloc Alloc_ushort
- | Uchar -> `Alloc Alloc_uchar
+ | Uchar -> `Noalloc Noalloc_uchar
  | Uint -> `Alloc Alloc_uint
  | Ulong -> `Alloc Alloc_ulong
  | Ullong -> `Alloc Alloc_ullong
  | Size_t -> `Alloc Alloc_size_t
  | Int32_t -> `Alloc Alloc_int32_t
  | Int64_t -> `Alloc Alloc_int64_t
- | Uint8_t -> `Alloc Alloc_uint8_t
- | Uint16_t -> `Alloc Alloc_uint16_t
+ | Uint8_t -> `Noalloc Noalloc_uint8_t
+ | Uint16_t -> `Noalloc Noalloc_uint16_t
  | Uint32_t -> `Alloc Alloc_uint32_t
  | Uint64_t -> `Alloc Alloc_uint64_t
  | Nativeint -> `Alloc Alloc_nativeint
@@ -84,14 +131,17 @@ let primitive_allocation : type a. a Primitives.prim -> a allocation =
  | Double -> `Alloc Alloc_float
  | Complex32 -> `Alloc Alloc_complex
  | Complex64 -> `Alloc Alloc_complex
+ | Long_as_int -> `Alloc Alloc_checked_int
+ | Llong_as_int -> `Alloc Alloc_checked_int
+ | Size_t_as_int -> `Alloc Alloc_checked_int
 
 let rec allocation : type a. a typ -> a allocation = function
  | Void -> `Noalloc Noalloc_unit
  | Primitive p -> primitive_allocation p
  | Pointer _ -> `Alloc Alloc_pointer
- | Struct _ -> `Alloc Alloc_structured
- | Union _ -> `Alloc Alloc_structured
- | Abstract _ -> `Alloc Alloc_structured
+ | Struct _ -> `Noalloc Noalloc_structured
+ | Union _ -> `Noalloc Noalloc_structured
+ | Abstract _ -> `Alloc Alloc_abstract
  | View v ->
    begin match allocation v.ty with
    | `Alloc a -> `Alloc (Alloc_view (v, a))
@@ -107,3 +157,22 @@ let rec may_allocate : type a. a fn -> bool = function
     | `Alloc _ -> true
     end
   | Function (_, t) -> may_allocate t
+
+(* Converting an argument of these types raises an exception if the value is
+   out of range for the C type. *)
+let rec may_raise_on_arg : type a. a typ -> bool = function
+  | Primitive (Primitives.Long_as_int | Primitives.Size_t_as_int) -> true
+  | View { ty } -> may_raise_on_arg ty
+  | _ -> false
+
+(* Converting a result of these types raises an exception if the value is out
+   of range for an OCaml int. *)
+let rec may_raise_on_return : type a. a typ -> bool = function
+  | Primitive (Primitives.Long_as_int | Primitives.Llong_as_int
+              | Primitives.Size_t_as_int) -> true
+  | View { ty } -> may_raise_on_return ty
+  | _ -> false
+
+let rec may_raise : type a. a fn -> bool = function
+  | Returns t -> may_raise_on_return t
+  | Function (f, t) -> may_raise_on_arg f || may_raise t
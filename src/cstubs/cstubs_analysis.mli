@@ -7,5 +7,14 @@
 
 (* Analysis for stub generation *)
 
+type unboxed_repr = Unboxed_float | Untagged_int | Unboxed_int64
+
 val float : 'a Static.fn -> bool
+val unboxed_repr : 'a Static.typ -> unboxed_repr option
+val is_pointer : 'a Static.typ -> bool
+val is_structured : 'a Static.typ -> bool
+val returns_structured : 'a Static.fn -> bool
+val unboxed_attributes : bool
+val native_unboxed : 'a Static.fn -> bool
 val may_allocate : 'a Static.fn -> bool
+val may_raise : 'a Static.fn -> bool
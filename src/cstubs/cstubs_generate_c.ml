@@ -31,12 +31,17 @@ type cexp = [ cconst
             | `Cast of ty * cexp
             | `Addr of cexp ]
 type ceff = [ `App of [`Fn] cglobal * cexp list
-            | `Deref of cexp ]
+            | `Deref of cexp
+            (* Store the value of an expression at an address *)
+            | `Store of cexp * ceff ]
 type cbind = clocal * ceff
 type ccomp = [ cexp
              | ceff
              | `Let of cbind * ccomp ]
-type cfundec = [ `Function of string * string list * ccomp ]
+(* A function definition: the name, the parameters, the return type, the
+   parameters registered as local roots, and the body. *)
+type cfundec =
+  [ `Function of string * (string * ty) list * ty * string list * ccomp ]
 
 let max_byte_args = 5
 
@@ -62,6 +67,7 @@ struct
         "dereferencing expression of non-pointer type %s"
         (Ctypes.string_of_typ t)
       end
+    | `Store _ -> Ty Void
 
   let rec ccomp : ccomp -> ty = function
     | #cexp as e -> cexp e
@@ -111,7 +117,7 @@ struct
     | `Cast (ty, e) -> fprintf fmt "@[@[(%a)@]%a@]" format_ty ty (cexp env) e
     | `Addr e -> fprintf fmt "@[&@[%a@]@]" (cexp env) e
 
-  let ceff env fmt : ceff -> unit = function
+  let rec ceff env fmt : ceff -> unit = function
     | `App (v, es) ->
       fprintf fmt "@[%s(@[" (cvar_name v);
       let last_exp = List.length es - 1 in
@@ -122,32 +128,61 @@ struct
         es;
       fprintf fmt ")@]@]";
     | `Deref e -> fprintf fmt "@[*@[%a@]@]" (cexp env) e
+    | `Store (p, e) ->
+      fprintf fmt "@[*@[%a@]@;=@;@[%a@]@]" (cexp env) p (ceff env) e
 
-  let rec ccomp env fmt : ccomp -> unit = function
-    | #cexp as e -> fprintf fmt "@[<2>return@;@[%a@]@];" (cexp env) e
-    | #ceff as e -> fprintf fmt "@[<2>return@;@[%a@]@];" (ceff env) e
+  (* A function that registers local roots must return through CAMLreturnT,
+     which takes the return type. *)
+  type return = Return | CAMLreturnT of ty
+
+  let return ret pp fmt e = match ret with
+    | Return -> fprintf fmt "@[<2>return@;@[%a@]@];" pp e
+    | CAMLreturnT ty ->
+      fprintf fmt "@[<2>CAMLreturnT(@[%a,@;%a@]);@]" format_ty ty pp e
+
+  let rec ccomp ret env fmt : ccomp -> unit = function
+    | #cexp as e -> return ret (cexp env) fmt e
+    | #ceff as e -> return ret (ceff env) fmt e
     | `Let ((`Local (name, Ty Void), e), s) ->
-      fprintf fmt "@[%a;@]@ %a" (ceff env) e (ccomp env) s
+      fprintf fmt "@[%a;@]@ %a" (ceff env) e (ccomp ret env) s
     | `Let ((`Local (name, Ty (Struct { tag })), e), s) ->
       fprintf fmt "@[struct@;%s@;%s@;=@;@[%a;@]@]@ %a"
-        tag name (ceff env) e (ccomp env) s
+        tag name (ceff env) e (ccomp ret env) s
     | `Let ((`Local (name, Ty (Union { utag })), e), s) ->
       fprintf fmt "@[union@;%s@;%s@;=@;@[%a;@]@]@ %a"
-        utag name (ceff env) e (ccomp env) s
+        utag name (ceff env) e (ccomp ret env) s
     | `Let ((`Local (name, Ty ty), e), s) ->
       fprintf fmt "@[@[%a@]@;=@;@[%a;@]@]@ %a"
-        (Ctypes.format_typ ~name) ty (ceff env) e (ccomp env) s
-
-  let cfundec fmt (`Function (f, xs, body) : cfundec) =
-    fprintf fmt "@[value@;%s(@[" f;
+        (Ctypes.format_typ ~name) ty (ceff env) e (ccomp ret env) s
+
+  (* CAMLparam registers at most five roots; the remainder are registered in
+     groups of up to five with CAMLxparam. *)
+  let rec local_roots macro fmt = function
+    | [] -> ()
+    | roots ->
+      let rec split n l = match n, l with
+        | 0, _ | _, [] -> [], l
+        | n, x :: xs -> let ys, zs = split (n - 1) xs in x :: ys, zs in
+      let group, rest = split 5 roots in
+      fprintf fmt "@[%s%d(%s);@]@\n" macro (List.length group)
+        (String.concat ", " group);
+      local_roots "CAMLxparam" fmt rest
+
+  let cfundec fmt (`Function (f, xs, rt, roots, body) : cfundec) =
+    fprintf fmt "@[%a@;%s(@[" format_ty rt f;
     let xs_len = List.length xs - 1 in
     List.iteri
-      (fun i x ->
-        fprintf fmt "value %s%(%)" x
+      (fun i (x, Ty ty) ->
+        fprintf fmt "%a%(%)" (Ctypes.format_typ ~name:x) ty
           (if i <> xs_len then ",@ " else ""))
       xs;
-    fprintf fmt ")@]@]@\n{@[<v 2>@\n%a@]@\n}@\n" (ccomp []) body;
-    let nargs = List.length xs in
+    let ret = if roots = [] then Return else CAMLreturnT rt in
+    fprintf fmt ")@]@]@\n{@[<v 2>@\n%a%a@]@\n}@\n"
+      (local_roots "CAMLparam") roots (ccomp ret []) body
+
+  (* The bytecode entry point for functions with too many arguments to pass
+     individually. *)
+  let byte_stub fmt f nargs =
     if nargs > max_byte_args then
       begin
         fprintf fmt "@[value@;%s_byte%d(value *argv, int argn)@]@\n{" f nargs;
@@ -157,10 +192,19 @@ struct
           else fprintf fmt "argv[%d])@]@]@];@\n}@." i
         done
       end
+
+  let byte_fundec fmt (`Function (f, xs, _, _, _) : cfundec) =
+    byte_stub fmt f (List.length xs)
 end
 
 let value = abstract ~name:"value" ~size:0 ~alignment:0
 
+(* The C type of an argument or result passed in unboxed form. *)
+let unboxed_type : Cstubs_analysis.unboxed_repr -> ty = function
+  | Cstubs_analysis.Unboxed_float -> Ty double
+  | Cstubs_analysis.Untagged_int -> Ty camlint
+  | Cstubs_analysis.Unboxed_int64 -> Ty int64_t
+
 module Generate_C =
 struct
   let var_counter = ref 0
@@ -220,12 +264,15 @@ struct
     | Double -> reader "Double_val" (value @-> returning double)
     | Complex32 -> reader "ctypes_float_complex_val" (value @-> returning complex32)
     | Complex64 -> reader "ctypes_double_complex_val" (value @-> returning complex64)
+    | Long_as_int -> reader "ctypes_long_as_int_val" (value @-> returning long)
+    | Llong_as_int -> reader "ctypes_llong_as_int_val" (value @-> returning llong)
+    | Size_t_as_int -> reader "ctypes_size_t_as_int_val" (value @-> returning size_t)
 
   let prim_inj : type a. a Primitives.prim -> _ =
     let open Primitives in function
     | Char -> immediater "Val_int" (int @-> returning value)
     | Schar -> immediater "Val_int" (int @-> returning value)
-    | Uchar -> conser "ctypes_copy_uint8" (uint8_t @-> returning value)
+    | Uchar -> immediater "ctypes_copy_uint8" (uint8_t @-> returning value)
     | Short -> immediater "Val_int" (int @-> returning value)
     | Int -> immediater "Val_int" (int @-> returning value)
     | Long -> conser "ctypes_copy_long" (long @-> returning value)
@@ -239,8 +286,8 @@ struct
     | Int16_t -> immediater "Val_int" (int @-> returning value)
     | Int32_t -> conser "caml_copy_int32" (int32_t @-> returning value)
     | Int64_t -> conser "caml_copy_int64" (int64_t @-> returning value)
-    | Uint8_t -> conser "ctypes_copy_uint8" (uint8_t @-> returning value)
-    | Uint16_t -> conser "ctypes_copy_uint16" (uint16_t @-> returning value)
+    | Uint8_t -> immediater "ctypes_copy_uint8" (uint8_t @-> returning value)
+    | Uint16_t -> immediater "ctypes_copy_uint16" (uint16_t @-> returning value)
     | Uint32_t -> conser "ctypes_copy_uint32" (uint32_t @-> returning value)
     | Uint64_t -> conser "ctypes_copy_uint64" (uint64_t @-> returning value)
     | Camlint -> immediater "Val_int" (int @-> returning value)
@@ -249,6 +296,9 @@ struct
     | Double -> conser "caml_copy_double" (double @-> returning value)
     | Complex32 -> conser "ctypes_copy_float_complex" (complex32 @-> returning value)
     | Complex64 -> conser "ctypes_copy_double_complex" (complex64 @-> returning value)
+    | Long_as_int -> conser "ctypes_copy_long_as_int" (long @-> returning value)
+    | Llong_as_int -> conser "ctypes_copy_llong_as_int" (llong @-> returning value)
+    | Size_t_as_int -> conser "ctypes_copy_size_t_as_int" (size_t @-> returning value)
 
   let to_ptr : cexp -> ccomp =
     fun x -> `App (`Global (reader "CTYPES_TO_PTR" (value @-> returning (ptr void))),
@@ -258,6 +308,21 @@ struct
     fun x -> `App (`Global (conser "CTYPES_FROM_PTR" (ptr void @-> returning value)),
                    [x])
 
+  let ba_data : cexp -> ccomp =
+    fun x -> `App (`Global (reader "Caml_ba_data_val" (value @-> returning (ptr void))),
+                   [x])
+
+  let carray_addr : cexp -> ccomp =
+    fun x -> `App (`Global (reader "CTYPES_ADDR_OF_CARRAY" (value @-> returning (ptr void))),
+                   [x])
+
+  let fatptr_addr : cexp -> ccomp =
+    fun x -> `App (`Global (reader "CTYPES_ADDR_OF_FATPTR" (value @-> returning (ptr void))),
+                   [x])
+
+  let blocking_section name : ccomp =
+    `App (`Global (immediater name (void @-> returning void)), [])
+
   let val_unit : ccomp = `Global { name = "Val_unit";
                                    allocates = false;
                                    reads_ocaml_heap = false;
@@ -290,16 +355,31 @@ struct
             `Deref (`Cast (Ty (ptr ty), y)))
     | Abstract _ -> report_unpassable "values of abstract type"
     | View { ty } -> prj ty x
-    | Array _ -> report_unpassable "arrays"
-    | Bigarray _ -> report_unpassable "bigarrays"
+    | Array _ ->
+      let Ty elt_ptr = param_type ty in
+      Some ((carray_addr x, ptr void) >>= fun y -> `Cast (Ty elt_ptr, y))
+    | Bigarray _ ->
+      let Ty elt_ptr = param_type ty in
+      Some ((ba_data x, ptr void) >>= fun y -> `Cast (Ty elt_ptr, y))
+
+  (* The type of the C variable that holds an argument: array arguments are
+     passed as pointers to their first element. *)
+  and param_type : type a. a typ -> ty = function
+    | Array (elt, _, _) -> Ty (ptr elt)
+    | Bigarray b -> Ty (ptr (Primitive (Ctypes_bigarray.element_type b)))
+    | View { ty } -> param_type ty
+    | ty -> Ty ty
 
   let rec inj : type a. a typ -> cexp -> ccomp =
     fun ty x -> match ty with
     | Void -> val_unit
     | Primitive p -> `App (`Global (prim_inj p), [`Cast (Ty (Primitive p), x)])
     | Pointer _ -> from_ptr x
-    | Struct s -> `App (copy_bytes, [`Addr x; `Int (sizeof ty)])
-    | Union u -> `App (copy_bytes, [`Addr x; `Int (sizeof ty)])
+    (* Generated stubs store structured results in memory supplied by the
+       caller, so structured values are copied only when they are passed to
+       OCaml functions exported to C. *)
+    | Struct _ -> `App (copy_bytes, [`Addr x; `Int (sizeof ty)])
+    | Union _ -> `App (copy_bytes, [`Addr x; `Int (sizeof ty)])
     | Abstract _ -> report_unpassable "values of abstract type"
     | View { ty } -> inj ty x
     | Array _ -> report_unpassable "arrays"
@@ -313,32 +393,263 @@ struct
     | Returns t -> Returns t
     | Function (f, t) -> Function (fresh_var (), f, name_params t)
 
-  let rec params : type a. a fn -> string list = function
+  (* In a stub with unboxed arguments, arguments and results of the types
+     identified by [Cstubs_analysis.unboxed_repr] are passed in C form. *)
+  let repr : type a. unboxed:bool -> a typ -> ty option =
+    fun ~unboxed ty ->
+      if not unboxed then None
+      else match Cstubs_analysis.unboxed_repr ty with
+        | None -> None
+        | Some r -> Some (unboxed_type r)
+
+  let rec params : type a. unboxed:bool -> a fn -> (string * ty) list =
+    fun ~unboxed -> function
     | Returns t -> []
-    | Function (x, _, t) -> x :: params t
-
-  let fn : type a. cname:string -> stub_name:string -> a Static.fn -> cfundec =
-    fun ~cname ~stub_name f ->
+    | Function (x, f, t) ->
+      let ty = match repr ~unboxed f with None -> Ty value | Some ty -> ty in
+      (x, ty) :: params ~unboxed t
+
+  (* The type of a pointer to the memory that receives a structured result. *)
+  let rec result_ptr_type : type a. a typ -> ty = function
+    | View { ty } -> result_ptr_type ty
+    | ty -> Ty (ptr ty)
+
+  let rec result_type : type a. unboxed:bool -> a fn -> ty =
+    fun ~unboxed -> function
+    | Returns t ->
+      begin match repr ~unboxed t with None -> Ty value | Some ty -> ty end
+    | Function (_, _, t) -> result_type ~unboxed t
+
+  (* Run [c] with the runtime lock released.  The arguments have already
+     been copied out of the OCaml heap; the result is converted to an OCaml
+     value after the lock is reacquired. *)
+  let without_runtime_lock : type a. ccomp * a typ -> (cexp -> ccomp) -> ccomp =
+    fun (c, ty) k ->
+      `Let ((`Local (fresh_var (), Ty Void),
+             blocking_section "caml_enter_blocking_section"),
+            (c, ty) >>= fun x ->
+            `Let ((`Local (fresh_var (), Ty Void),
+                   blocking_section "caml_leave_blocking_section"),
+                  k x))
+
+  let fn : type a. unboxed:bool -> release_runtime_lock:bool -> cname:string ->
+    stub_name:string -> a Static.fn -> cfundec =
+    fun ~unboxed ~release_runtime_lock ~cname ~stub_name f ->
       let fvar = `Global { name = cname;
                            allocates = false;
                            reads_ocaml_heap = false;
                            tfn = Fn f; } in
+      (* A struct or union result is stored directly into memory allocated
+         by the caller, which passes its address as an additional final
+         argument, so that the stub itself never allocates.  The OCaml
+         wrapper allocates that memory with malloc on each call (see
+         Cstubs_internals.make_structured_result), except in bindings made
+         with [foreign_into], whose callers supply it. *)
+      let dst =
+        if Cstubs_analysis.returns_structured f then Some (fresh_var ())
+        else None in
       let rec body : type a. _ -> a fn -> _ =
          fun vars -> function 
          | Returns t ->
-           (`App (fvar, (List.rev vars :> cexp list)), t) >>= fun x ->
-           inj t x
+           let call = `App (fvar, (List.rev vars :> cexp list)) in
+           begin match dst with
+           | Some d ->
+             (to_ptr (`Local (d, Ty value)), ptr void) >>= fun p ->
+             let store = `Store (`Cast (result_ptr_type t, p), call) in
+             let result _ = val_unit in
+             if release_runtime_lock then without_runtime_lock (store, Void) result
+             else (store, Void) >>= result
+           | None ->
+             let result x = match repr ~unboxed t with
+               | None -> inj t x
+               | Some ty -> `Cast (ty, x) in
+             if release_runtime_lock then without_runtime_lock (call, t) result
+             else (call, t) >>= result
+           end
          | Function (x, f, t) ->
-           begin match prj f (`Local (x, Ty value)) with
-             None -> body vars t
-           | Some projected -> 
-             (projected, f) >>= fun x' ->
-             body (x' :: vars) t
+           begin match repr ~unboxed f with
+           | Some ty -> body (`Cast (param_type f, `Local (x, ty)) :: vars) t
+           | None ->
+             (* Pointer arguments to functions that release the runtime lock
+                are passed as Ctypes.ptr values, which the stub registers as
+                local roots, so that the memory they reference is not
+                collected during the call. *)
+             let projected =
+               if release_runtime_lock && Cstubs_analysis.is_pointer f
+               then Some (fatptr_addr (`Local (x, Ty value)))
+               else prj f (`Local (x, Ty value)) in
+             begin match projected with
+               None -> body vars t
+             | Some projected -> 
+               let Ty pty = param_type f in
+               (projected, pty) >>= fun x' ->
+               body (x' :: vars) t
+             end
            end
       in
       let f' = name_params f in
-      `Function (stub_name, params f', body [] f')
+      let params = match dst with
+        | None -> params ~unboxed f'
+        | Some d -> params ~unboxed f' @ [(d, Ty value)] in
+      let roots =
+        if not release_runtime_lock then []
+        else List.map fst (List.filter (fun (_, ty) -> ty = Ty value) params) in
+      `Function (stub_name, params, result_type ~unboxed f', roots, body [] f')
 end
 
-let fn ~cname  ~stub_name fmt fn =
-  Emit_C.cfundec fmt (Generate_C.fn ~stub_name ~cname fn)
+let fn ~cname ~stub_name ~release_runtime_lock fmt fn =
+  let boxed = Generate_C.fn ~unboxed:false ~release_runtime_lock ~stub_name
+      ~cname fn in
+  begin
+    Emit_C.cfundec fmt boxed;
+    Emit_C.byte_fundec fmt boxed;
+    if Cstubs_analysis.native_unboxed fn then
+      Emit_C.cfundec fmt
+        (Generate_C.fn ~unboxed:true ~release_runtime_lock
+           ~stub_name:(stub_name ^ "_unboxed") ~cname fn)
+  end
+
+(* The C type of the elements of an array of values of type [t]. *)
+let rec element_type : type a. a typ -> ty = function
+  | View { ty } -> element_type ty
+  | Void -> raise (Unsupported "cstubs does not support batching over void")
+  | Abstract _ | Array _ | Bigarray _ as ty ->
+    let msg = Printf.sprintf "cstubs does not support batching over %s"
+        (Ctypes.string_of_typ ty) in
+    raise (Unsupported msg)
+  | ty -> Ty ty
+
+let rec batch_elements : type a. a Static.fn -> ty list * ty = function
+  | Returns t -> [], element_type t
+  | Function (t, f) ->
+    let ts, r = batch_elements f in element_type t :: ts, r
+
+(* A stub that calls the C function [cname] on the corresponding elements of
+   a group of CArray arguments, storing the results in a final CArray
+   argument.  The loop is compiled along with the C function, so the call
+   can be inlined and the loop vectorised. *)
+let batch ~cname ~stub_name ~release_runtime_lock fmt fn =
+  let open Format in
+  let args, Ty rt = batch_elements fn in
+  let fresh _ = Generate_C.fresh_var () in
+  let xs = List.map fresh args and out = fresh () in
+  let data = List.map fresh args and out_data = fresh () in
+  let params = xs @ [out] in
+  let declare_data x d (Ty t) =
+    fprintf fmt "@[%a@;=@;CTYPES_ADDR_OF_CARRAY(%s);@]@\n"
+      (Ctypes.format_typ ~name:d) (ptr t) x in
+  begin
+    fprintf fmt "@[value@;%s(@[%s@])@]@\n{@[<v 2>@\n" stub_name
+      (String.concat ", " (List.map (fun x -> "value " ^ x) params));
+    if release_runtime_lock then Emit_C.local_roots "CAMLparam" fmt params;
+    fprintf fmt "size_t i, n = CTYPES_CARRAY_LENGTH(%s);@\n" out;
+    List.iter2 (fun (x, d) t -> declare_data x d t) (List.combine xs data) args;
+    declare_data out out_data (Ty rt);
+    fprintf fmt "@[<hov 2>if (%s)@ caml_invalid_argument(%S);@]@\n"
+      (String.concat " || "
+         (List.map (Printf.sprintf "CTYPES_CARRAY_LENGTH(%s) != n") xs))
+      (cname ^ ": arrays of different lengths");
+    if release_runtime_lock then fprintf fmt "caml_enter_blocking_section();@\n";
+    fprintf fmt "@[<hov 2>for (i = 0; i < n; i++)@ %s[i] = %s(%s);@]@\n"
+      out_data cname
+      (String.concat ", " (List.map (fun d -> d ^ "[i]") data));
+    if release_runtime_lock then
+      fprintf fmt "caml_leave_blocking_section();@\nCAMLreturn(Val_unit);@]@\n}@\n"
+    else fprintf fmt "return Val_unit;@]@\n}@\n";
+    Emit_C.byte_stub fmt stub_name (List.length params)
+  end
+
+let rec named_params : type a. a Static.fn -> (string * ty) list * ty = function
+  | Returns t -> [], Ty t
+  | Function (t, f) ->
+    let xs, r = named_params f in (Generate_C.fresh_var (), Ty t) :: xs, r
+
+(* The declarator of a C function with named parameters.  Parameters of type
+   void, which indicate a function with no arguments, are omitted. *)
+let declarator name params =
+  let params = List.filter (function (_, Ty Void) -> false | _ -> true) params in
+  Printf.sprintf "%s(%s)" name
+    (match params with
+     | [] -> "void"
+     | ps -> String.concat ", "
+               (List.map (fun (x, Ty t) -> Ctypes.string_of_typ ~name:x t) ps))
+
+(* A C function [cname] of type [fn] that calls the OCaml function
+   registered as [callback_name].  The arguments are converted to OCaml
+   values, which are registered as local roots until the call, and the
+   result is converted back to C.  The trampolines for function pointers
+   additionally pass their [slot] number as the first argument. *)
+let callback_fn ?slot ~cname ~callback_name fmt fn =
+  let open Format in
+  let xs, Ty rt = named_params fn in
+  let slot_args = match slot with None -> 0 | Some _ -> 1 in
+  let nargs = slot_args + List.length xs in
+  let assign i (x, Ty t) =
+    fprintf fmt "@[<hov 2>args[%d] =@ " i;
+    begin match Generate_C.inj t (`Local (x, Ty t)) with
+    | #cexp as e -> Emit_C.cexp [] fmt e
+    | #ceff as e -> Emit_C.ceff [] fmt e
+    | `Let _ -> internal_error "unexpected binding converting %s" x
+    end;
+    fprintf fmt ";@]@\n" in
+  let result = `Local ("result", Ty value) in
+  begin
+    fprintf fmt "@[%s%a@]@\n{@[<v 2>@\n"
+      (if slot = None then "" else "static ")
+      (Ctypes.format_typ ~name:(declarator cname xs)) rt;
+    fprintf fmt "static const value *closure = NULL;@\n";
+    fprintf fmt "CAMLparam0();@\nCAMLlocal1(result);@\n";
+    fprintf fmt "CAMLlocalN(args, %d);@\n" nargs;
+    fprintf fmt "@[<v 2>if (closure == NULL) {@\n";
+    fprintf fmt "closure = caml_named_value(%S);@\n" callback_name;
+    fprintf fmt "@[<hov 2>if (closure == NULL)@ caml_failwith(%S);@]@]@\n}@\n"
+      (Printf.sprintf "Cstubs: no OCaml function registered as %s"
+         callback_name);
+    begin match slot with
+    | None -> ()
+    | Some i -> fprintf fmt "args[0] = Val_int(%d);@\n" i
+    end;
+    List.iteri (fun i x -> assign (i + slot_args) x) xs;
+    fprintf fmt "result = caml_callbackN(*closure, %d, args);@\n" nargs;
+    begin match Generate_C.prj rt result with
+    | None -> fprintf fmt "CAMLreturn0;"
+    | Some c -> Emit_C.ccomp (Emit_C.CAMLreturnT (Ty rt)) [] fmt c
+    end;
+    fprintf fmt "@]@\n}@\n@."
+  end
+
+let inverted_fn ~cname ~callback_name fmt fn =
+  callback_fn ~cname ~callback_name fmt fn
+
+(* The C functions for a function pointer type [fn]:
+
+   - [name_call], which calls a function pointer of type [fn] passed as its
+     first argument, and which is bound by a generated stub;
+   - [slots] trampolines of type [fn], each of which calls the OCaml
+     dispatcher registered as [name], passing its slot number;
+   - [name_slot], a stub that returns the address of a trampoline. *)
+let funptr ~name ~slots fmt fn =
+  let open Format in
+  let xs, Ty rt = named_params fn in
+  let f = Generate_C.fresh_var () in
+  let call_args =
+    List.map fst (List.filter (function (_, Ty Void) -> false | _ -> true) xs) in
+  let format_pointer_type fmt =
+    Type_printing.format_fn' fn (fun fmt -> fprintf fmt "(*)") fmt in
+  begin
+    fprintf fmt "@[static %a@]@\n{@[<v 2>@\n"
+      (Ctypes.format_typ
+         ~name:(declarator (name ^ "_call") ((f, Ty (ptr void)) :: xs))) rt;
+    fprintf fmt "@[<hov 2>%s((%t)%s)(%s);@]@]@\n}@\n"
+      (match rt with Void -> "" | _ -> "return ")
+      format_pointer_type f (String.concat ", " call_args);
+    for slot = 0 to slots - 1 do
+      callback_fn ~slot ~cname:(Printf.sprintf "%s_%d" name slot)
+        ~callback_name:name fmt fn
+    done;
+    fprintf fmt "@[value@;%s_slot(value slot)@]@\n{@[<v 2>@\n" name;
+    fprintf fmt "@[<hov 2>static void *const slots[] = {@ %s@ };@]@\n"
+      (String.concat ", "
+         (Array.to_list (Array.init slots (Printf.sprintf "(void *)%s_%d" name))));
+    fprintf fmt "return CTYPES_FROM_PTR(slots[Int_val(slot)]);@]@\n}@\n@."
+  end
@@ -7,5 +7,14 @@
 
 (* C stub generation *)
 
-val fn : cname:string -> stub_name:string -> Format.formatter ->
-         'a Ctypes.fn -> unit
+val fn : cname:string -> stub_name:string -> release_runtime_lock:bool ->
+         Format.formatter -> 'a Ctypes.fn -> unit
+
+val batch : cname:string -> stub_name:string -> release_runtime_lock:bool ->
+         Format.formatter -> 'a Ctypes.fn -> unit
+
+val inverted_fn : cname:string -> callback_name:string ->
+         Format.formatter -> 'a Ctypes.fn -> unit
+
+val funptr : name:string -> slots:int -> Format.formatter ->
+         ('a -> 'b) Ctypes.fn -> unit
@@ -14,7 +14,8 @@ open Cstubs_errors
 type lident = string
 type ml_type = [ `Ident of path
 	       | `Appl of path * ml_type list
-	       | `Fn of ml_type * ml_type ]
+	       | `Fn of ml_type * ml_type
+	       | `Attr of ml_type * string ]
 
 type ml_external_type = [ `Prim of ml_type list * ml_type ]
 
@@ -30,6 +31,8 @@ type ml_pat = [ `Var of string
 type ml_exp = [ `Ident of path 
               | `Project of ml_exp * path
               | `MakePtr of ml_exp * ml_exp
+              (* Allocate a struct or union, and pass its address to a
+                 function that stores a C result there *)
               | `MakeStructured of ml_exp * ml_exp
               | `Appl of ml_exp * ml_exp 
               | `Fun of lident list * ml_exp ]
@@ -87,28 +90,34 @@ struct
       fprintf fmt "@[(%a@ ->@ %a)@]" (ml_type ArrowParens) t (ml_type NoArrowParens) t'
     | NoArrowParens, `Fn (t, t') ->
       fprintf fmt "@[%a@ ->@]@ %a" (ml_type ArrowParens) t (ml_type NoArrowParens) t'
+    | _, `Attr (t, attr) ->
+      fprintf fmt "@[(%a@ [@@%s])@]" (ml_type NoArrowParens) t attr
 
   let ml_external_type fmt (`Prim (args, ret) : ml_external_type) =
     List.iter (fprintf fmt "@[%a@ ->@]@ " (ml_type ArrowParens)) args;
     ml_type ArrowParens fmt ret
 
-  let primname_opt fmt = function
-    | None -> ()
-    | Some primname -> fprintf fmt "%S@ " primname
-
-  let attrs fmt { float; noalloc } =
-    begin 
-    (* TODO: float support not yet implemented *)
-    (* if float then pp_print_string fmt "\"float\""; *)
-
-    (* TODO: fix this.  The may_allocate function determines whether any of
-       the functions in the generated C cause OCaml heap allocations.
-       However, it doesn't currently account for callbacks: if we pass a
-       handle to an OCaml function into C, calling the function can trigger an
-       allocation.  We need some way in the interface of the library for the
-       client to indicate whether it is safe to assume that a C function
-       cannot call back into OCaml. *)
-    (* if noalloc then pp_print_string fmt "\"noalloc\"" *)
+  (* The noalloc attribute is only set for bindings whose C functions the
+     client has asserted never call back into OCaml: the stub analysis
+     cannot see allocations made by callbacks.
+
+     Compilers that support [@unboxed] take [@@noalloc].  Earlier compilers
+     read the old-style "noalloc" only directly after the first name, and
+     "float" only after the second. *)
+  let primnames fmt { primname; primname_byte; attributes = { float; noalloc } } =
+    let old_noalloc = noalloc && not Cstubs_analysis.unboxed_attributes in
+    begin
+      begin match primname_byte with
+      | None -> fprintf fmt "%S" primname
+      | Some byte -> fprintf fmt "%S" byte
+      end;
+      if old_noalloc then fprintf fmt "@ \"noalloc\"";
+      begin match primname_byte with
+      | None -> ()
+      | Some _ -> fprintf fmt "@ %S" primname
+      end;
+      if float then fprintf fmt "@ \"float\"";
+      if noalloc && not old_noalloc then fprintf fmt "@ [@@@@noalloc]"
     end
 
   let args fmt xs =
@@ -128,10 +137,10 @@ struct
         "@[<hov 2>CI.make_ptr@ %a@ %a@]" (ml_exp ApplParens) t (ml_exp ApplParens) e
     | ApplParens, `MakeStructured (t, e) ->
       fprintf fmt
-        "(@[<hov 2>CI.make_structured@ %a@ %a)@]" (ml_exp ApplParens) t (ml_exp ApplParens) e
+        "(@[<hov 2>CI.make_structured_result@ %a@ %a)@]" (ml_exp ApplParens) t (ml_exp ApplParens) e
     | NoApplParens, `MakeStructured (t, e) ->
       fprintf fmt
-        "@[<hov 2>CI.make_structured@ %a@ %a@]" (ml_exp ApplParens) t (ml_exp ApplParens) e
+        "@[<hov 2>CI.make_structured_result@ %a@ %a@]" (ml_exp ApplParens) t (ml_exp ApplParens) e
     | _, `Fun (xs, e) ->
       fprintf fmt "(@[<1>fun@ %a->@ %a)@]" args xs (ml_exp NoApplParens) e
 
@@ -163,13 +172,11 @@ struct
           else fprintf fmt "%a" (ml_pat NoApplParens))
         xs
 
-  let extern fmt { ident; typ; primname; primname_byte; attributes } =
+  let extern fmt ({ ident; typ } as e) =
     fprintf fmt
       "@[<hov 2>@[external@ %s@]@ @[<h 1>:@ @[%a@]@]@ "
       ident ml_external_type typ;
-    fprintf fmt
-      "@[=@ @[@[%a@]@[%S@]@ %a@]@]@]@."
-      primname_opt primname_byte primname attrs attributes
+    fprintf fmt "@[=@ @[%a@]@]@]@." primnames e
 end
 
 let rec arity : ml_external_type -> int =
@@ -184,9 +191,26 @@ let byte_stub_name : string -> ml_external_type -> string option =
     then Some (Printf.sprintf "%s_byte%d" name arity)
     else None
 
-let attributes : type a. a fn -> attributes =
+(* A binding with a native stub that takes unboxed arguments uses the usual
+   stub in bytecode. *)
+let primnames : type a. string -> ml_external_type -> a fn ->
+  string * string option =
+  fun name t fn ->
+    if Cstubs_analysis.native_unboxed fn then
+      let byte = match byte_stub_name name t with
+        | Some byte -> byte
+        | None -> name in
+      (name ^ "_unboxed", Some byte)
+    else (name, byte_stub_name name t)
+
+(* A stub that releases the runtime lock must not be noalloc. *)
+let attributes : type a. noalloc:bool -> release_runtime_lock:bool -> a fn ->
+  attributes =
    let open Cstubs_analysis in
-   fun fn -> { float = float fn; noalloc = not (may_allocate fn) }
+   fun ~noalloc ~release_runtime_lock fn ->
+     { float = not unboxed_attributes && float fn;
+       noalloc = noalloc && not release_runtime_lock
+                 && not (may_allocate fn) && not (may_raise fn) }
 
 let managed_buffer = `Ident (path_of_string "Memory_stubs.managed_buffer")
 let voidp = `Ident (path_of_string "CI.voidp")
@@ -197,8 +221,8 @@ let rec ml_typ_of_return_typ : type a. a typ -> ml_type =
   function
   | Void -> `Ident (path_of_string "unit")
   | Primitive p -> `Ident (Cstubs_public_name.ident_of_ml_prim (Primitives.ml_prim p))
-  | Struct _    -> managed_buffer
-  | Union _     -> managed_buffer
+  | Struct _ | Union _ as s -> internal_error
+    "Unexpected structured type in the return type: %s" (Ctypes.string_of_typ s)
   | Abstract _  -> managed_buffer
   | Pointer _   -> voidp
   | View { ty } -> ml_typ_of_return_typ ty
@@ -207,46 +231,68 @@ let rec ml_typ_of_return_typ : type a. a typ -> ml_type =
   | Bigarray _ as a -> internal_error
     "Unexpected bigarray type in the return type: %s" (Ctypes.string_of_typ a)
 
-let rec ml_typ_of_arg_typ : type a. a typ -> ml_type = function
+(* Stubs that release the runtime lock receive pointer arguments as
+   Ctypes.ptr values, passed as Obj.t. *)
+let rec ml_typ_of_arg_typ : type a. release_runtime_lock:bool -> a typ -> ml_type =
+  fun ~release_runtime_lock -> function
   | Void -> `Ident (path_of_string "unit")
   | Primitive p -> `Ident (Cstubs_public_name.ident_of_ml_prim (Primitives.ml_prim p))
+  | Pointer _ when release_runtime_lock -> `Ident (path_of_string "Obj.t")
   | Pointer _   -> voidp
   | Struct _    -> voidp
   | Union _     -> voidp
   | Abstract _  -> voidp
-  | View { ty } -> ml_typ_of_arg_typ ty
-  | Array _    as a -> internal_error
-    "Unexpected array in an argument type: %s" (Ctypes.string_of_typ a)
-  | Bigarray _ as a -> internal_error
-    "Unexpected bigarray in an argument type: %s" (Ctypes.string_of_typ a)
-
-let rec ml_external_type_of_fn : type a. a fn -> ml_external_type = function
-  | Returns t -> `Prim ([], ml_typ_of_return_typ t)
+  | View { ty } -> ml_typ_of_arg_typ ~release_runtime_lock ty
+  (* The array and bigarray types are not determined by a match on the typ,
+     so array and bigarray arguments are passed to the external as Obj.t. *)
+  | Array _     -> `Ident (path_of_string "Obj.t")
+  | Bigarray _  -> `Ident (path_of_string "Obj.t")
+
+(* Annotate the types of arguments and results that the native stub receives
+   unboxed. *)
+let unboxed_attr : type a. a typ -> ml_type -> ml_type =
+  fun ty t ->
+    if not Cstubs_analysis.unboxed_attributes then t
+    else match Cstubs_analysis.unboxed_repr ty with
+      | None -> t
+      | Some Cstubs_analysis.Untagged_int -> `Attr (t, "untagged")
+      | Some (Cstubs_analysis.Unboxed_float | Cstubs_analysis.Unboxed_int64) ->
+        `Attr (t, "unboxed")
+
+let rec ml_external_type_of_fn : type a. release_runtime_lock:bool -> a fn ->
+  ml_external_type = fun ~release_runtime_lock -> function
+  (* Structured results are written to the address passed as a final
+     argument. *)
+  | Returns t when Cstubs_analysis.is_structured t ->
+    `Prim ([voidp], `Ident (path_of_string "unit"))
+  | Returns t -> `Prim ([], unboxed_attr t (ml_typ_of_return_typ t))
   | Function (f, t) ->
-    let `Prim (l, t) = ml_external_type_of_fn t in
-    `Prim (ml_typ_of_arg_typ f :: l, t)
+    let `Prim (l, t) = ml_external_type_of_fn ~release_runtime_lock t in
+    `Prim (unboxed_attr f (ml_typ_of_arg_typ ~release_runtime_lock f) :: l, t)
 
 let var_counter = ref 0
 let fresh_var () =
   incr var_counter;
   Printf.sprintf "x%d" !var_counter
 
-let extern ~stub_name ~external_name fmt fn =
+let extern ~stub_name ~external_name ~noalloc ~release_runtime_lock fmt fn =
   let ext =
-    let typ = ml_external_type_of_fn fn in
+    let typ = ml_external_type_of_fn ~release_runtime_lock fn in
+    let primname, primname_byte = primnames stub_name typ fn in
     ({ ident = external_name;
        typ = typ;
-       primname = stub_name;
-       primname_byte = byte_stub_name stub_name typ;
-       attributes = attributes fn; }) in
+       primname;
+       primname_byte;
+       attributes = attributes ~noalloc ~release_runtime_lock fn; }) in
   Format.fprintf fmt "%a@." Emit_ML.extern ext
 
 let static_con c args =
   `Con (Ctypes_path.path_of_string ("CI." ^ c), args)
 
 let rec pattern_and_exp_of_typ :
-  type a. a typ -> ml_exp -> [`Arg | `Ret ] -> ml_pat * ml_exp option =
-  fun typ e pol -> match typ with
+  type a. release_runtime_lock:bool -> a typ -> ml_exp -> [`Arg | `Ret ] ->
+  ml_pat * ml_exp option =
+  fun ~release_runtime_lock typ e pol -> match typ with
   | Void ->
     (static_con "Void" [], None)
   | Primitive p ->
@@ -256,6 +302,8 @@ let rec pattern_and_exp_of_typ :
     let x = fresh_var () in
     let pat = static_con "Pointer" [`Var x] in
     begin match pol with
+    | `Arg when release_runtime_lock ->
+      (pat, Some (`Appl (`Ident (path_of_string "Obj.repr"), e)))
     | `Arg -> (pat, Some (`Project (e, path_of_string "CI.raw_ptr")))
     | `Ret -> (pat, Some (`MakePtr (`Ident (path_of_string x), e)))
     end
@@ -266,7 +314,10 @@ let rec pattern_and_exp_of_typ :
     | `Arg ->
       (pat, Some (`Project (`Appl (`Ident (path_of_string "Ctypes.addr"), e),
                             path_of_string "CI.raw_ptr")))
-    | `Ret -> (pat, Some (`MakeStructured (`Ident (path_of_string x), e)))
+    | `Ret ->
+      let dst = fresh_var () in
+      (pat, Some (`MakeStructured (`Ident (path_of_string x),
+                                   `Fun ([dst], `Appl (e, `Ident (path_of_string dst))))))
     end
   | Union _ ->
     let x = fresh_var () in
@@ -275,7 +326,10 @@ let rec pattern_and_exp_of_typ :
     | `Arg ->
       (pat, Some (`Project (`Appl (`Ident (path_of_string "Ctypes.addr"), e),
                             path_of_string "CI.raw_ptr")))
-    | `Ret -> (pat, Some (`MakeStructured (`Ident (path_of_string x), e)))
+    | `Ret ->
+      let dst = fresh_var () in
+      (pat, Some (`MakeStructured (`Ident (path_of_string x),
+                                   `Fun ([dst], `Appl (e, `Ident (path_of_string dst))))))
     end
   | View { ty } ->
     begin match pol  with
@@ -283,14 +337,14 @@ let rec pattern_and_exp_of_typ :
       let x = fresh_var () in
       let e = `Appl (`Ident (path_of_string x), e) in
       let (p, None), e | (p, Some e), _ =
-        pattern_and_exp_of_typ ty e pol, e in
+        pattern_and_exp_of_typ ~release_runtime_lock ty e pol, e in
       let pat = static_con "View"
         [`Record [path_of_string "CI.ty", p;
                   path_of_string "write", `Var x]] in
       (pat, Some e)
     | `Ret -> 
       let (p, None), e | (p, Some e), _ =
-        pattern_and_exp_of_typ ty e pol, e in
+        pattern_and_exp_of_typ ~release_runtime_lock ty e pol, e in
       let x = fresh_var () in
       let pat = static_con "View"
         [`Record [path_of_string "CI.ty", p;
@@ -300,12 +354,22 @@ let rec pattern_and_exp_of_typ :
   | Abstract _ as ty -> internal_error
     "Unexpected abstract type encountered during ML code generation: %s"
     (Ctypes.string_of_typ ty)
-  | Array _ as ty -> internal_error
-    "Unexpected array type encountered during ML code generation: %s"
-    (Ctypes.string_of_typ ty)
-  | Bigarray _ as ty -> internal_error
-    "Unexpected bigarray type encountered during ML code generation: %s"
-    (Ctypes.string_of_typ ty)
+  | Array _ as ty ->
+    begin match pol with
+    | `Arg -> (static_con "Array" [`Underscore],
+               Some (`Appl (`Ident (path_of_string "Obj.repr"), e)))
+    | `Ret -> internal_error
+      "Unexpected array type in the return type: %s"
+      (Ctypes.string_of_typ ty)
+    end
+  | Bigarray _ as ty ->
+    begin match pol with
+    | `Arg -> (static_con "Bigarray" [`Underscore],
+               Some (`Appl (`Ident (path_of_string "Obj.repr"), e)))
+    | `Ret -> internal_error
+      "Unexpected bigarray type in the return type: %s"
+      (Ctypes.string_of_typ ty)
+    end
 
 type wrapper_state = {
   pat: ml_pat;
@@ -314,10 +378,11 @@ type wrapper_state = {
   trivial: bool;
 }
 
-let rec wrapper_body : type a. a fn -> ml_exp -> wrapper_state =
-  fun fn exp -> match fn with
+let rec wrapper_body : type a. release_runtime_lock:bool -> a fn -> ml_exp ->
+  wrapper_state =
+  fun ~release_runtime_lock fn exp -> match fn with
   | Returns t ->
-    begin match pattern_and_exp_of_typ t exp `Ret with
+    begin match pattern_and_exp_of_typ ~release_runtime_lock t exp `Ret with
       pat, None -> { exp ; args = []; trivial = true;
                      pat = static_con "Returns" [pat] }
     | pat, Some exp -> { exp; args = []; trivial = false;
@@ -325,29 +390,102 @@ let rec wrapper_body : type a. a fn -> ml_exp -> wrapper_state =
     end
   | Function (f, t) ->
     let x = fresh_var () in
-    begin match pattern_and_exp_of_typ f (`Ident (path_of_string x)) `Arg with
+    begin match pattern_and_exp_of_typ ~release_runtime_lock f
+                  (`Ident (path_of_string x)) `Arg with
     | fpat, None ->
       let { exp; args; trivial; pat = tpat } =
-        wrapper_body t (`Appl (exp, `Ident (path_of_string x))) in
+        wrapper_body ~release_runtime_lock t
+          (`Appl (exp, `Ident (path_of_string x))) in
       { exp; args = x :: args; trivial;
         pat = static_con "Function" [fpat; tpat] }
     | fpat, Some exp' ->
       let { exp; args = xs; trivial; pat = tpat } =
-        wrapper_body t (`Appl (exp, exp')) in
+        wrapper_body ~release_runtime_lock t (`Appl (exp, exp')) in
       { exp; args = x :: xs; trivial = false;
         pat = static_con "Function" [fpat; tpat] }
     end
 
-let wrapper : type a. a fn -> string -> ml_pat * ml_exp option =
-  fun fn f -> match wrapper_body fn (`Ident (path_of_string f)) with
-    { trivial = true; pat } -> (pat, None)
-  | { exp; args; pat } -> (pat, Some (`Fun (args, exp)))
+let wrapper : type a. release_runtime_lock:bool -> a fn -> string ->
+  ml_pat * ml_exp option =
+  fun ~release_runtime_lock fn f ->
+    match wrapper_body ~release_runtime_lock fn (`Ident (path_of_string f)) with
+      { trivial = true; pat } -> (pat, None)
+    | { exp; args; pat } -> (pat, Some (`Fun (args, exp)))
 
-let case ~stub_name ~external_name fmt fn =
-  let p, e = match wrapper fn external_name with
+let case ~index ~external_name ~release_runtime_lock fmt fn =
+  let p, e = match wrapper ~release_runtime_lock fn external_name with
       pat, None -> pat, `Ident (path_of_string external_name)
     | pat, Some e -> pat, e
   in
-  Format.fprintf fmt "@[<hov 2>@[<h 2>|@ @[%S,@ @[%a@]@]@ ->@]@ "
-    stub_name Emit_ML.(ml_pat NoApplParens) p;
+  Format.fprintf fmt "@[<hov 2>@[<h 2>|@ @[%d,@ @[%a@]@]@ ->@]@ "
+    index Emit_ML.(ml_pat NoApplParens) p;
+  Format.fprintf fmt "@[<hov 2>@[%a@]@]@]@." Emit_ML.(ml_exp ApplParens) e
+
+(* A batch stub receives each argument array, and the result array, as an
+   Obj.t. *)
+let rec batch_external_type : type a. a fn -> ml_external_type = function
+  | Returns _ -> `Prim ([`Ident (path_of_string "Obj.t")],
+                        `Ident (path_of_string "unit"))
+  | Function (_, t) ->
+    let `Prim (l, t) = batch_external_type t in
+    `Prim (`Ident (path_of_string "Obj.t") :: l, t)
+
+let batch_extern ~stub_name ~external_name fmt fn =
+  let typ = batch_external_type fn in
+  let ext = { ident = external_name;
+              typ;
+              primname = stub_name;
+              primname_byte = byte_stub_name stub_name typ;
+              attributes = { float = false; noalloc = false } } in
+  Format.fprintf fmt "%a@." Emit_ML.extern ext
+
+let batch_con c args =
+  `Con (Ctypes_path.path_of_string ("Cstubs." ^ c), args)
+
+(* The shape of the batch description determines the type of the batched
+   function, so the element types need not be matched. *)
+let rec batch_pattern : type a. a fn -> ml_pat = function
+  | Returns _ -> batch_con "Batch_returns" [`Underscore]
+  | Function (_, t) -> batch_con "Batch_function" [`Underscore; batch_pattern t]
+
+let batch_case ~index ~external_name fmt fn =
+  let `Prim (args, _) = batch_external_type fn in
+  let xs = List.map (fun _ -> fresh_var ()) args in
+  let e = `Fun (xs, List.fold_left
+                  (fun e x -> `Appl (e, `Appl (`Ident (path_of_string "Obj.repr"),
+                                              `Ident (path_of_string x))))
+                  (`Ident (path_of_string external_name) : ml_exp) xs) in
+  Format.fprintf fmt "@[<hov 2>@[<h 2>|@ @[%d,@ @[%a@]@]@ ->@]@ "
+    index Emit_ML.(ml_pat NoApplParens) (batch_pattern fn);
   Format.fprintf fmt "@[<hov 2>@[%a@]@]@]@." Emit_ML.(ml_exp ApplParens) e
+
+let into_con c args =
+  `Con (Ctypes_path.path_of_string ("Cstubs." ^ c), args)
+
+(* The external of a function bound with [foreign_into] is the external of
+   the C function, which already takes the address of the memory that
+   receives its structured result as a final argument.  The result type is
+   not matched, since the external ignores it. *)
+let rec into_body : type a. a fn -> ml_exp -> ml_pat * lident list * ml_exp =
+  fun fn exp -> match fn with
+  | Returns _ ->
+    let dst = fresh_var () in
+    (into_con "Into_returns" [`Underscore], [dst],
+     `Appl (exp, `Appl (`Ident (path_of_string "CI.address"),
+                        `Ident (path_of_string dst))))
+  | Function (f, t) ->
+    let x = fresh_var () in
+    let fpat, arg =
+      match pattern_and_exp_of_typ ~release_runtime_lock:false f
+              (`Ident (path_of_string x)) `Arg with
+      | fpat, None -> fpat, `Ident (path_of_string x)
+      | fpat, Some e -> fpat, e in
+    let tpat, xs, e = into_body t (`Appl (exp, arg)) in
+    (into_con "Into_function" [fpat; tpat], x :: xs, e)
+
+let into_case ~index ~external_name fmt fn =
+  let pat, xs, e = into_body fn (`Ident (path_of_string external_name)) in
+  Format.fprintf fmt "@[<hov 2>@[<h 2>|@ @[%d,@ @[%a@]@]@ ->@]@ "
+    index Emit_ML.(ml_pat NoApplParens) pat;
+  Format.fprintf fmt "@[<hov 2>@[%a@]@]@]@." Emit_ML.(ml_exp ApplParens)
+    (`Fun (xs, e))
@@ -7,8 +7,19 @@
 
 (* ML stub generation *)
 
-val extern : stub_name:string -> external_name:string -> Format.formatter ->
-         ('a -> 'b) Ctypes.fn -> unit
+val extern : stub_name:string -> external_name:string -> noalloc:bool ->
+         release_runtime_lock:bool -> Format.formatter -> ('a -> 'b) Ctypes.fn ->
+         unit
 
-val case : stub_name:string -> external_name:string -> Format.formatter ->
-         ('a -> 'b) Ctypes.fn -> unit
+val case : index:int -> external_name:string ->
+         release_runtime_lock:bool -> Format.formatter -> ('a -> 'b) Ctypes.fn ->
+         unit
+
+val batch_extern : stub_name:string -> external_name:string ->
+         Format.formatter -> ('a -> 'b) Ctypes.fn -> unit
+
+val batch_case : index:int -> external_name:string ->
+         Format.formatter -> ('a -> 'b) Ctypes.fn -> unit
+
+val into_case : index:int -> external_name:string ->
+         Format.formatter -> ('a -> 'b) Ctypes.fn -> unit
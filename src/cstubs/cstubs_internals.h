@@ -10,9 +10,32 @@
 
 /* Types and functions used by generated C code. */
 
+#include <caml/mlvalues.h>
+#include <caml/memory.h>
+#include <caml/signals.h>
+#include <caml/fail.h>
+#include <caml/callback.h>
+#include <caml/bigarray.h>
+
 #include "ctypes/primitives.h"
 #include "ctypes/complex_stubs.h"
 #include "ctypes/raw_pointer.h"
 #include "ctypes/managed_buffer_stubs.h"
 
+/* The address referenced by a Ctypes.ptr value, whose second and fourth
+   fields are the raw pointer and the byte offset. */
+#define CTYPES_ADDR_OF_FATPTR(p) \
+  ((void *)((char *)CTYPES_TO_PTR(Field(p, 1)) + Long_val(Field(p, 3))))
+
+/* The address of the first element of a Ctypes.CArray.t value, whose first
+   field is the Ctypes.ptr to the start of the array. */
+#define CTYPES_ADDR_OF_CARRAY(a) CTYPES_ADDR_OF_FATPTR(Field(a, 0))
+
+/* The number of elements of a Ctypes.CArray.t value. */
+#define CTYPES_CARRAY_LENGTH(a) ((size_t)Long_val(Field(a, 1)))
+
+/* The C type of values of the ctypes type camlint, which is also the type of
+   untagged int arguments and results. */
+typedef intnat camlint;
+
 #endif /* CSTUBS_INTERNALS_H */
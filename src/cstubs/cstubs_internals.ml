@@ -18,8 +18,235 @@ let make_structured reftype buf =
   let pbyte_offset = 0 in
   { structured = { reftype; pmanaged; pbyte_offset; raw_ptr } }
 
+let make_structured_result reftype write =
+  let buf = Memory_stubs.allocate (Static.sizeof reftype) in
+  begin
+    write (Memory_stubs.block_address buf);
+    make_structured reftype buf
+  end
+
 include Static
 include Primitives
 
 let make_ptr reftype raw_ptr =
   { reftype; raw_ptr; pmanaged = None; pbyte_offset = 0 }
+
+let unsupported ty =
+  let msg = Printf.sprintf "cstubs does not support passing %s to OCaml"
+      (Ctypes.string_of_typ ty) in
+  raise (Unsupported msg)
+
+(* Generated C functions that call OCaml pass arguments and receive results
+   in the representations used by the generated stubs: pointers and
+   structured values are passed as addresses, and views as the underlying
+   values. *)
+let rec of_c : type a. a typ -> Obj.t -> a = function
+  | Void -> fun _ -> ()
+  | Primitive _ -> Obj.obj
+  | Pointer reftype -> fun v -> make_ptr reftype (Obj.obj v)
+  | Struct _ as ty -> fun v -> make_structured ty (Obj.obj v)
+  | Union _ as ty -> fun v -> make_structured ty (Obj.obj v)
+  | View { read; ty } -> let c = of_c ty in fun v -> read (c v)
+  | Abstract _ as ty -> unsupported ty
+  | Array _ as ty -> unsupported ty
+  | Bigarray _ as ty -> unsupported ty
+
+and to_c : type a. a typ -> a -> Obj.t = function
+  | Void -> Obj.repr
+  | Primitive _ -> Obj.repr
+  | Pointer _ -> fun p -> Obj.repr (address p)
+  | Struct _ -> fun { structured } -> Obj.repr (address structured)
+  | Union _ -> fun { structured } -> Obj.repr (address structured)
+  | View { write; ty } -> let c = to_c ty in fun v -> c (write v)
+  | Abstract _ as ty -> unsupported ty
+  | Array _ as ty -> unsupported ty
+  | Bigarray _ as ty -> unsupported ty
+
+and address : type a. a ptr -> voidp = fun { raw_ptr; pbyte_offset } ->
+  Ctypes_raw.PtrType.(add raw_ptr (of_int pbyte_offset))
+
+(* The conversions are computed once, when the function type is given. *)
+let rec wrap_function : type a. a fn -> a -> Obj.t = function
+  | Returns t -> to_c t
+  | Function (t, f) ->
+    let arg = of_c t and res = wrap_function f in
+    fun g -> Obj.repr (fun x -> res (g (arg x)))
+
+let funptr_key fn =
+  Printf.sprintf "%Lx" Ctypes.Type_id.(representation (of_fn fn))
+
+let format_function_pointer fn k fmt =
+  Type_printing.format_fn' fn (fun fmt -> Format.fprintf fmt "(*%t)" k) fmt
+
+let funptr_view fn ~read ~write =
+  Static.view ~format_typ:(format_function_pointer fn) ~read ~write
+    (Pointer Void)
+
+type funptr_pool = {
+  fp_name : string;
+  fp_functions : Obj.t Weak.t;
+  fp_wrappers : (Obj.t -> Obj.t) array;
+  fp_slot_address : int -> voidp;
+}
+
+(* The trampolines of a pool call the dispatcher registered under the pool's
+   name, passing the slot number followed by the arguments.  The slots hold
+   the functions weakly, as with closures created by Foreign. *)
+let funptr_pool ~name ~slots ~slot_address =
+  let pool = { fp_name = name;
+               fp_functions = Weak.create slots;
+               fp_wrappers = Array.make slots (fun _ -> raise CallToExpiredClosure);
+               fp_slot_address = slot_address } in
+  let dispatch slot = match Weak.get pool.fp_functions slot with
+    | Some f -> pool.fp_wrappers.(slot) f
+    | None -> raise CallToExpiredClosure in
+  begin
+    Callback.register name dispatch;
+    pool
+  end
+
+let find_slot { fp_functions } f =
+  let n = Weak.length fp_functions in
+  let rec find i free =
+    if i = n then free
+    else match Weak.get fp_functions i with
+      | Some g when g == f -> Some i
+      | None when free = None -> find (i + 1) (Some i)
+      | _ -> find (i + 1) free in
+  find 0 None
+
+let pointer_of_function pool fn =
+  let wrapper = wrap_function fn in
+  fun f ->
+    let f = Obj.repr f in
+    let slot = match find_slot pool f with
+      | Some slot -> slot
+      | None ->
+        (* Collect unreachable functions to free their slots. *)
+        Gc.full_major ();
+        match find_slot pool f with
+        | Some slot -> slot
+        | None -> failwith
+          (Printf.sprintf "Cstubs: all %d trampolines for %s are in use"
+             (Weak.length pool.fp_functions) pool.fp_name) in
+    begin
+      Weak.set pool.fp_functions slot (Some f);
+      pool.fp_wrappers.(slot) <- (fun f -> wrapper (Obj.obj f));
+      make_ptr Void (pool.fp_slot_address slot)
+    end
+
+let make_funptr pool fn call =
+  funptr_view fn ~read:call ~write:(pointer_of_function pool fn)
+
+(* The C name of a struct or union type, which identifies its layout in the
+   code generated by Cstubs_structs. *)
+let structured_name : type a s. (a, s) structured typ -> string = function
+  | Struct { tag } -> "struct " ^ tag
+  | Union { utag } -> "union " ^ utag
+  | Abstract { aname } -> aname
+  | _ -> raise (Unsupported "layout of non-structured type")
+
+(* Fields and sealing with the offsets, sizes and alignments reported by the
+   C compiler, in place of the layout computed by Structs_computed. *)
+let add_field (type k) (structured : (_, k) structured typ) fname ~offset ftype =
+  match structured with
+  | Struct ({ spec = Incomplete _; packing } as s) ->
+    let falign = Structs_computed.member_alignment packing ftype in
+    let field = { ftype; foffset = offset; fname; falign } in
+    s.fields <- BoxedField field :: s.fields;
+    field
+  | Union ({ uspec = None; upacking } as u) ->
+    let falign = Structs_computed.member_alignment upacking ftype in
+    let field = { ftype; foffset = offset; fname; falign } in
+    u.ufields <- BoxedField field :: u.ufields;
+    field
+  | Struct { tag; spec = Complete _ } -> raise (ModifyingSealedType tag)
+  | Union { utag } -> raise (ModifyingSealedType utag)
+  | _ -> raise (Unsupported "Adding a field to non-structured type")
+
+let seal (type a) (type s) (structured : (a, s) structured typ) ~size ~align =
+  match structured with
+  | Struct { fields = [] } -> raise (Unsupported "struct with no fields")
+  | Struct { spec = Complete _; tag } -> raise (ModifyingSealedType tag)
+  | Struct ({ spec = Incomplete _ } as s) ->
+    s.fields <- List.rev s.fields;
+    s.spec <- Complete { size; align }
+  | Union { utag; uspec = Some _ } -> raise (ModifyingSealedType utag)
+  | Union { ufields = [] } -> raise (Unsupported "union with no fields")
+  | Union u ->
+    u.ufields <- List.rev u.ufields;
+    u.uspec <- Some { size; align }
+  | _ -> raise (Unsupported "Sealing a non-structured type")
+
+(* Constants are printed by the generated C program in decimal, as signed or
+   unsigned long long or as double, according to their types. *)
+let prim_of_string : type a. a prim -> string -> a = function
+  | Char -> fun s -> Char.chr (int_of_string s land 0xff)
+  | Schar -> int_of_string
+  | Uchar -> Unsigned.UChar.of_string
+  | Short -> int_of_string
+  | Int -> int_of_string
+  | Long -> Signed.Long.of_string
+  | Llong -> Signed.LLong.of_string
+  | Ushort -> Unsigned.UShort.of_string
+  | Uint -> Unsigned.UInt.of_string
+  | Ulong -> Unsigned.ULong.of_string
+  | Ullong -> Unsigned.ULLong.of_string
+  | Size_t -> Unsigned.Size_t.of_string
+  | Int8_t -> int_of_string
+  | Int16_t -> int_of_string
+  | Int32_t -> Int32.of_string
+  | Int64_t -> Int64.of_string
+  | Uint8_t -> Unsigned.UInt8.of_string
+  | Uint16_t -> Unsigned.UInt16.of_string
+  | Uint32_t -> Unsigned.UInt32.of_string
+  | Uint64_t -> Unsigned.UInt64.of_string
+  | Camlint -> int_of_string
+  | Nativeint -> Nativeint.of_string
+  | Float -> float_of_string
+  | Double -> float_of_string
+  | Complex32 -> raise (Unsupported "complex constants")
+  | Complex64 -> raise (Unsupported "complex constants")
+  | Long_as_int -> int_of_string
+  | Llong_as_int -> int_of_string
+  | Size_t_as_int -> int_of_string
+
+let rec constant_of_string : type a. a typ -> string -> a = function
+  | Primitive p -> prim_of_string p
+  | View { read; ty } -> let c = constant_of_string ty in fun s -> read (c s)
+  | ty -> raise (Unsupported
+                   (Printf.sprintf "constants of type %s" (Ctypes.string_of_typ ty)))
+
+(* The integer type of the given size and signedness that represents an
+   enum, viewed as int64. *)
+let enum_representation ~size ~signed : int64 typ =
+  let open Ctypes in
+  let open Unsigned in
+  match size, signed with
+  | 1, true -> view ~read:Int64.of_int ~write:Int64.to_int int8_t
+  | 2, true -> view ~read:Int64.of_int ~write:Int64.to_int int16_t
+  | 4, true -> view ~read:Int64.of_int32 ~write:Int64.to_int32 int32_t
+  | 8, true -> int64_t
+  | 1, false -> view ~read:(fun x -> Int64.of_int (UInt8.to_int x))
+                  ~write:(fun x -> UInt8.of_int (Int64.to_int x)) uint8_t
+  | 2, false -> view ~read:(fun x -> Int64.of_int (UInt16.to_int x))
+                  ~write:(fun x -> UInt16.of_int (Int64.to_int x)) uint16_t
+  | 4, false ->
+    view ~read:(fun x -> Int64.logand (Int64.of_int32 (UInt32.to_int32 x))
+                           0xffffffffL)
+      ~write:(fun x -> UInt32.of_int32 (Int64.to_int32 x)) uint32_t
+  | 8, false -> view ~read:UInt64.to_int64 ~write:UInt64.of_int64 uint64_t
+  | _ -> raise (Unsupported (Printf.sprintf "enum of size %d" size))
+
+let build_enum_type name ?(typedef=false) ~size ~signed ?unexpected alist =
+  let cname = if typedef then name else "enum " ^ name in
+  let unexpected = match unexpected with
+    | Some f -> f
+    | None -> fun v -> failwith
+        (Printf.sprintf "Unexpected value %Ld for %s" v cname) in
+  let rlist = List.map (fun (l, r) -> (r, l)) alist in
+  let read v = try List.assoc v rlist with Not_found -> unexpected v
+  and write l = try List.assoc l alist with Not_found ->
+    invalid_arg "Cstubs_internals.build_enum_type" in
+  view ~format_typ:(fun k fmt -> Format.fprintf fmt "%s%t" cname k)
+    ~read ~write (enum_representation ~size ~signed)
@@ -18,6 +18,14 @@ type managed_buffer = Memory_stubs.managed_buffer
 val make_structured :
   ('a, 's) structured typ -> managed_buffer -> ('a, 's) structured
 
+(* [make_structured_result t write] allocates a value of type [t] and passes
+   its address to [write], which stores the result of a C call there.  The
+   value is held in a C buffer allocated with malloc and owned by a custom
+   block, as for [Ctypes.make]: OCaml heap memory cannot be used, since the
+   collector may move it while the value holds its address. *)
+val make_structured_result :
+  ('a, 's) structured typ -> (voidp -> unit) -> ('a, 's) structured
+
 type 'a ptr = 'a Static.ptr
   = { reftype      : 'a typ;
       raw_ptr      : voidp;
@@ -26,6 +34,9 @@ type 'a ptr = 'a Static.ptr
 
 val make_ptr : 'a typ -> voidp -> 'a ptr
 
+val address : 'a ptr -> voidp
+(* [address p] is the address referenced by [p], including its offset. *)
+
 type 'a typ = 'a Static.typ =
     Void            :                              unit typ
   | Primitive       : 'a Primitives.prim        -> 'a typ 
@@ -34,13 +45,15 @@ type 'a typ = 'a Static.typ =
   | Union           : 'a Static.union_type      -> 'a Static.union typ
   | Abstract        : Static.abstract_type      -> 'a Static.abstract typ
   | View            : ('a, 'b) view             -> 'a typ
-  | Array           : 'a typ * int              -> 'a Static.carray typ
+  | Array           : 'a typ * int * Static.layout_cache
+                                                -> 'a Static.carray typ
   | Bigarray        : (_, 'a) Ctypes_bigarray.t -> 'a typ
 and ('a, 'b) view = ('a, 'b) Static.view = {
   read : 'b -> 'a;
   write : 'a -> 'b;
   format_typ: ((Format.formatter -> unit) -> Format.formatter -> unit) option;
   ty: 'b typ;
+  vcache: Static.layout_cache;
 }
 
 type 'a fn = 'a Static.fn =
@@ -74,3 +87,56 @@ type 'a prim = 'a Primitives.prim =
 | Double : float prim
 | Complex32 : Complex.t prim
 | Complex64 : Complex.t prim
+| Long_as_int : int prim
+| Llong_as_int : int prim
+| Size_t_as_int : int prim
+
+val wrap_function : 'a fn -> 'a -> Obj.t
+(* [wrap_function fn f] is a function that receives its arguments from
+   generated C code, and returns its result to generated C code, in the
+   representations used by the generated stubs. *)
+
+val funptr_key : 'a fn -> string
+(* The key that identifies the trampolines for a function pointer type.
+   Types whose values are converted differently, such as [int -> int] and
+   [int -> bool], have different keys. *)
+
+val funptr_view : ('a -> 'b) fn -> read:(unit ptr -> 'a -> 'b) ->
+  write:(('a -> 'b) -> unit ptr) -> ('a -> 'b) typ
+
+type funptr_pool
+
+val funptr_pool : name:string -> slots:int -> slot_address:(int -> voidp) ->
+  funptr_pool
+(* [funptr_pool ~name ~slots ~slot_address] registers the dispatcher for
+   the [slots] trampolines generated under [name], whose addresses are given
+   by [slot_address]. *)
+
+val make_funptr : funptr_pool -> ('a -> 'b) fn -> (unit ptr -> 'a -> 'b) ->
+  ('a -> 'b) typ
+(* [make_funptr pool fn call] is a function pointer type that passes OCaml
+   functions to C through the trampolines in [pool], and calls C function
+   pointers with [call]. *)
+
+val structured_name : (_, _) structured typ -> string
+(* The C name of a struct or union type: [struct tag] or [union tag]. *)
+
+val add_field : 't typ -> string -> offset:int -> 'a typ ->
+  ('a, (('s, [<`Struct | `Union]) structured as 't)) field
+(* [add_field t label ~offset ty] adds a field at the given offset, as
+   reported by the C compiler. *)
+
+val seal : (_, [< `Struct | `Union]) structured typ -> size:int -> align:int ->
+  unit
+(* [seal t ~size ~align] completes [t] with the given size and alignment, as
+   reported by the C compiler. *)
+
+val constant_of_string : 'a typ -> string -> 'a
+(* [constant_of_string t s] is the value of type [t] printed as [s] by the
+   program generated by Cstubs_structs. *)
+
+val build_enum_type : string -> ?typedef:bool -> size:int -> signed:bool ->
+  ?unexpected:(int64 -> 'a) -> ('a * int64) list -> 'a typ
+(* [build_enum_type name ~size ~signed alist] is a view of the C enum type
+   [name], whose representation has the given size and signedness, that
+   maps the values in [alist] to their constants. *)
@@ -0,0 +1,38 @@
+(*
+ * Copyright (c) 2014 Jeremy Yallop.
+ *
+ * This file is distributed under the terms of the MIT License.
+ * See the file LICENSE for details.
+ *)
+
+(* Cstubs_inverted public interface: exporting OCaml functions to C. *)
+
+module type INTERNAL =
+sig
+  val internal : string -> ('a -> 'b) Ctypes.fn -> ('a -> 'b) -> unit
+end
+
+module type BINDINGS = functor (I : INTERNAL) -> sig end
+
+let callback_name prefix name = prefix ^ name
+
+let write_c fmt ~prefix (module B : BINDINGS) =
+  let module M = B(struct
+    let internal name fn _ =
+      Cstubs_generate_c.inverted_fn ~cname:name
+        ~callback_name:(callback_name prefix name) fmt fn
+  end) in ()
+
+let write_c_header fmt ~prefix (module B : BINDINGS) =
+  let module M = B(struct
+    let internal name fn _ =
+      Format.fprintf fmt "@[%a;@]@\n" (Ctypes.format_fn ~name) fn
+  end) in
+  Format.pp_print_flush fmt ()
+
+let register ~prefix (module B : BINDINGS) =
+  let module M = B(struct
+    let internal name fn f =
+      Callback.register (callback_name prefix name)
+        (Cstubs_internals.wrap_function fn f)
+  end) in ()
@@ -0,0 +1,41 @@
+(*
+ * Copyright (c) 2014 Jeremy Yallop.
+ *
+ * This file is distributed under the terms of the MIT License.
+ * See the file LICENSE for details.
+ *)
+
+(* Cstubs_inverted public interface: exporting OCaml functions to C. *)
+
+module type INTERNAL =
+sig
+  val internal : string -> ('a -> 'b) Ctypes.fn -> ('a -> 'b) -> unit
+  (** [internal name typ f] exports the OCaml function [f] as the C function
+      [name] of type [typ]. *)
+end
+
+module type BINDINGS = functor (I : INTERNAL) -> sig end
+
+val write_c : Format.formatter -> prefix:string -> (module BINDINGS) -> unit
+(** [write_c fmt ~prefix bindings] generates C definitions for the functions
+    exported with [internal] in [bindings].  Each definition has the C type
+    given to [internal], and calls the corresponding OCaml function through
+    [caml_callbackN], so C code can call the OCaml function directly.
+
+    The OCaml functions must be registered with {!register}, using the same
+    [prefix], before the C functions are called; calling a C function whose
+    OCaml function has not been registered raises [Failure].  The C
+    functions must be called with the runtime lock held.
+
+    The generated code uses definitions exposed in the header file
+    [cstubs_internals.h]. *)
+
+val write_c_header : Format.formatter -> prefix:string -> (module BINDINGS) ->
+  unit
+(** [write_c_header fmt ~prefix bindings] generates declarations for the C
+    functions generated by {!write_c}. *)
+
+val register : prefix:string -> (module BINDINGS) -> unit
+(** [register ~prefix bindings] registers the functions exported with
+    [internal] in [bindings], so that they can be called by the C code
+    generated by {!write_c}. *)
@@ -60,6 +60,9 @@ let constructor_ident_of_prim : type a. a Primitives.prim -> path =
    | Double -> path_of_string "Ctypes.double"
    | Complex32 -> path_of_string "Ctypes.complex32"
    | Complex64 -> path_of_string "Ctypes.complex64"
+   | Long_as_int -> path_of_string "Ctypes.long_as_int"
+   | Llong_as_int -> path_of_string "Ctypes.llong_as_int"
+   | Size_t_as_int -> path_of_string "Ctypes.size_t_as_int"
 
 let constructor_cident_of_prim :
   type a. ?module_name:string -> a Primitives.prim -> path =
@@ -92,4 +95,7 @@ let constructor_cident_of_prim :
     | Float -> path "Float"
     | Double -> path "Double"
     | Complex32 -> path "Complex32"
-    | Complex64 -> path "Complex64")
+    | Complex64 -> path "Complex64"
+    | Long_as_int -> path "Long_as_int"
+    | Llong_as_int -> path "Llong_as_int"
+    | Size_t_as_int -> path "Size_t_as_int")
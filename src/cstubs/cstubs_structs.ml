@@ -0,0 +1,166 @@
+(*
+ * Copyright (c) 2014 Jeremy Yallop.
+ *
+ * This file is distributed under the terms of the MIT License.
+ * See the file LICENSE for details.
+ *)
+
+(* Generation of C programs that print struct layouts and constants. *)
+
+open Static
+
+module type TYPE =
+sig
+  type ('a, 's) field
+  val field : 't Ctypes.typ -> string -> 'a Ctypes.typ ->
+    ('a, (('s, [<`Struct | `Union]) Ctypes.structured as 't)) field
+  val seal : (_, [< `Struct | `Union]) Ctypes.structured Ctypes.typ -> unit
+  type 'a const
+  val constant : string -> 'a Ctypes.typ -> 'a const
+  val enum : string -> ?typedef:bool -> ?unexpected:(int64 -> 'a) ->
+    ('a * int64 const) list -> 'a Ctypes.typ
+end
+
+module type BINDINGS = functor (F : TYPE) -> sig end
+
+(* The printf conversion and the C type used to print a constant of the
+   given type.  The generated ML reads the value back with
+   Cstubs_internals.constant_of_string. *)
+let rec constant_format : type a. a typ -> string * string = function
+  | Primitive Primitives.(Char | Schar | Short | Int | Long | Llong
+                         | Int8_t | Int16_t | Int32_t | Int64_t
+                         | Camlint | Nativeint | Long_as_int | Llong_as_int) ->
+    "%lld", "long long"
+  | Primitive Primitives.(Uchar | Ushort | Uint | Ulong | Ullong | Size_t
+                         | Uint8_t | Uint16_t | Uint32_t | Uint64_t
+                         | Size_t_as_int) ->
+    "%llu", "unsigned long long"
+  | Primitive Primitives.(Float | Double) -> "%.17g", "double"
+  | View { ty } -> constant_format ty
+  | ty -> raise (Unsupported
+                   (Printf.sprintf "constants of type %s" (Ctypes.string_of_typ ty)))
+
+let c_string s =
+  let b = Buffer.create (String.length s + 2) in
+  begin
+    Buffer.add_char b '"';
+    String.iter (function
+      | '"' -> Buffer.add_string b "\\\""
+      | '\\' -> Buffer.add_string b "\\\\"
+      | '\n' -> Buffer.add_string b "\\n"
+      | c -> Buffer.add_char b c) s;
+    Buffer.add_char b '"';
+    Buffer.contents b
+  end
+
+(* Statements of the generated program that print ML text and the values
+   of C expressions. *)
+let puts fmt s =
+  Format.fprintf fmt "@[fputs(%s,@ stdout);@]@\n" (c_string s)
+
+let printf fmt conversion exp =
+  Format.fprintf fmt "@[printf(%s,@ %s);@]@\n" (c_string conversion) exp
+
+let print_size fmt exp = printf fmt "%lu" ("(unsigned long)" ^ exp)
+
+let enum_cname name typedef = if typedef then name else "enum " ^ name
+
+type constant = { cname : string; conversion : string; ctype : string }
+
+let write_prologue fmt =
+  begin
+    Format.fprintf fmt "#include <stddef.h>@\n#include <stdio.h>@\n@\n";
+    Format.fprintf fmt
+      "#define CTYPES_ALIGNOF(T) offsetof(struct { char c; T x; }, x)@\n@\n";
+    Format.fprintf fmt "int main(void)@\n{@[<v 2>@\n";
+    puts fmt "module CI = Cstubs_internals\n\n";
+    puts fmt "type ('a, 's) field = ('a, 's) Ctypes.field\n";
+    puts fmt "type 'a const = 'a\n\n";
+  end
+
+let write_fields fmt fields =
+  begin
+    puts fmt "let field s fname ftype =\n";
+    puts fmt "  match CI.structured_name s, fname with\n";
+    List.iter (fun (sname, fname) ->
+      puts fmt (Printf.sprintf "  | %S, %S ->\n    CI.add_field s fname ~offset:"
+                  sname fname);
+      print_size fmt (Printf.sprintf "offsetof(%s, %s)" sname fname);
+      puts fmt " ftype\n")
+      fields;
+    puts fmt "  | sname, fname ->\n";
+    puts fmt "    failwith (\"Unexpected field \" ^ sname ^ \".\" ^ fname)\n\n";
+  end
+
+let write_seals fmt seals =
+  begin
+    puts fmt "let seal s = match CI.structured_name s with\n";
+    List.iter (fun sname ->
+      puts fmt (Printf.sprintf "  | %S ->\n    CI.seal s ~size:" sname);
+      print_size fmt (Printf.sprintf "sizeof(%s)" sname);
+      puts fmt " ~align:";
+      print_size fmt (Printf.sprintf "CTYPES_ALIGNOF(%s)" sname);
+      puts fmt "\n")
+      seals;
+    puts fmt "  | sname -> failwith (\"Unexpected seal \" ^ sname)\n\n";
+  end
+
+let write_constants fmt constants =
+  begin
+    puts fmt "let constant name t = match name with\n";
+    List.iter (fun { cname; conversion; ctype } ->
+      puts fmt (Printf.sprintf "  | %S -> CI.constant_of_string t \"" cname);
+      printf fmt conversion (Printf.sprintf "(%s)(%s)" ctype cname);
+      puts fmt "\"\n")
+      constants;
+    puts fmt "  | _ -> failwith (\"Unexpected constant \" ^ name)\n\n";
+  end
+
+let write_enums fmt enums =
+  begin
+    puts fmt "let enum name ?typedef ?unexpected alist = match name with\n";
+    List.iter (fun (name, typedef) ->
+      let cname = enum_cname name typedef in
+      puts fmt (Printf.sprintf
+                  "  | %S ->\n    CI.build_enum_type name ?typedef ?unexpected alist\n      ~size:"
+                  name);
+      print_size fmt (Printf.sprintf "sizeof(%s)" cname);
+      puts fmt " ~signed:";
+      printf fmt "%s"
+        (Printf.sprintf "((%s)-1 < 0) ? \"true\" : \"false\"" cname);
+      puts fmt "\n")
+      enums;
+    puts fmt "  | _ -> failwith (\"Unexpected enum \" ^ name)\n";
+  end
+
+let write_c fmt (module B : BINDINGS) =
+  let fields = ref [] and seals = ref []
+  and constants = ref [] and enums = ref [] in
+  let module M = B(struct
+    type ('a, 's) field = unit
+    let field s fname _ =
+      fields := (Cstubs_internals.structured_name s, fname) :: !fields
+    let seal s =
+      seals := Cstubs_internals.structured_name s :: !seals
+    type 'a const = unit
+    let constant cname t =
+      let conversion, ctype = constant_format t in
+      constants := { cname; conversion; ctype } :: !constants
+    (* The view is used only for its C name during generation. *)
+    let enum name ?(typedef=false) ?unexpected:_ _ =
+      let cname = enum_cname name typedef in
+      let unavailable _ =
+        failwith (Printf.sprintf "Cstubs_structs: %s used during generation"
+                    cname) in
+      enums := (name, typedef) :: !enums;
+      Ctypes.view ~format_typ:(fun k fmt -> Format.fprintf fmt "%s%t" cname k)
+        ~read:unavailable ~write:unavailable Ctypes.int
+  end) in
+  begin
+    write_prologue fmt;
+    write_fields fmt (List.rev !fields);
+    write_seals fmt (List.rev !seals);
+    write_constants fmt (List.rev !constants);
+    write_enums fmt (List.rev !enums);
+    Format.fprintf fmt "return 0;@]@\n}@."
+  end
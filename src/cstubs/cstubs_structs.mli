@@ -0,0 +1,55 @@
+(*
+ * Copyright (c) 2014 Jeremy Yallop.
+ *
+ * This file is distributed under the terms of the MIT License.
+ * See the file LICENSE for details.
+ *)
+
+(** Struct layouts and constants determined by the C compiler.
+
+    Bindings written against {!TYPE} are passed to {!write_c}, which
+    generates a C program.  Compiling and running that program, with the
+    headers that declare the types and constants, prints an ML module that
+    implements {!TYPE} with the offsets, sizes, alignments and values that
+    the C compiler uses.  Applying the bindings to that module gives struct
+    and union types whose layouts are fixed when the module is compiled,
+    rather than computed when it is initialised. *)
+
+module type TYPE =
+sig
+  type ('a, 's) field
+  val field : 't Ctypes.typ -> string -> 'a Ctypes.typ ->
+    ('a, (('s, [<`Struct | `Union]) Ctypes.structured as 't)) field
+  (** [field ty label ty'] adds the member [label] of the struct or union
+      type [ty], which must be declared in C as [struct tag] or
+      [union tag], where [tag] is the tag passed to {!Ctypes.structure} or
+      {!Ctypes.union}.  Bitfields and flexible array members are not
+      supported. *)
+
+  val seal : (_, [< `Struct | `Union]) Ctypes.structured Ctypes.typ -> unit
+  (** [seal ty] completes [ty] with the size and alignment of the
+      corresponding C type. *)
+
+  type 'a const
+  val constant : string -> 'a Ctypes.typ -> 'a const
+  (** [constant name ty] is the value of the C constant expression [name],
+      such as a macro or an enum constant, which must have an integer or
+      floating type.  The value is converted to [ty]. *)
+
+  val enum : string -> ?typedef:bool -> ?unexpected:(int64 -> 'a) ->
+    ('a * int64 const) list -> 'a Ctypes.typ
+  (** [enum name ?typedef ?unexpected alist] is a view of the C type
+      [enum name], or of [name] if [typedef] is [true], that maps each OCaml
+      value in [alist] to the corresponding constant.  The view has the
+      size and signedness that the C compiler uses for the enum.  Reading a
+      value not in [alist] calls [unexpected], which by default raises
+      [Failure]. *)
+end
+
+module type BINDINGS = functor (F : TYPE) -> sig end
+
+val write_c : Format.formatter -> (module BINDINGS) -> unit
+(** [write_c fmt bindings] writes a C program to [fmt] that prints the ML
+    implementation of {!TYPE} for [bindings] on its standard output.  The
+    headers that declare the types and constants used in [bindings] should
+    be written to [fmt] first. *)
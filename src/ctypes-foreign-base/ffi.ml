@@ -68,9 +68,17 @@ struct
        (* Ensure that `bufspec' stays alive as long as the type does. *)
        keep_alive bufspec ~while_live:s;
        List.iteri
-         (fun i (BoxedField {ftype; foffset}) ->
-           let ArgType t = arg_type ftype in
-           Ffi_stubs.struct_type_set_argument bufspec i t)
+         (fun i -> function
+           | BoxedField {ftype; falign} when falign <> alignment ftype ->
+             (* libffi computes struct layouts from the natural alignment of
+                the members, so it cannot describe packed or overaligned
+                members. *)
+             report_unpassable "structs with packed or aligned members"
+           | BoxedField {ftype; foffset} ->
+             let ArgType t = arg_type ftype in
+             Ffi_stubs.struct_type_set_argument bufspec i t
+           | BoxedBitfield _ ->
+             report_unpassable "structs with bitfields")
          fields;
        Ffi_stubs.complete_struct_type bufspec;
        ArgType (Ffi_stubs.ffi_type_of_struct_type bufspec)
@@ -106,12 +114,55 @@ struct
         fun writers callspec addr v ->
           next (write v :: writers) callspec addr
 
+  (* Array and bigarray arguments are passed by address, as C passes
+     arrays. *)
+  let rec param_type : type a. a typ -> arg_type = function
+    | Array _ -> ArgType (Ffi_stubs.pointer_ffitype ())
+    | Bigarray _ -> ArgType (Ffi_stubs.pointer_ffitype ())
+    | View { ty } -> param_type ty
+    | ty -> arg_type ty
+
   let add_argument : type a. Ffi_stubs.callspec -> a typ -> int
     = fun callspec -> function
       | Void -> 0
-      | ty   -> let ArgType ffitype = arg_type ty in
+      | ty   -> let ArgType ffitype = param_type ty in
                 Ffi_stubs.add_argument callspec ffitype
 
+  (* Write an argument to the call buffer.  An array argument is written as
+     the address of its first element, and a bigarray argument as the
+     address of its data; the call's argument writers keep the array alive
+     until the call returns. *)
+  let rec write_arg : type a. a typ -> offset:int -> a -> Ctypes_raw.voidp -> unit
+    = function
+    | Array _ ->
+      (fun ~offset { astart = { raw_ptr; pbyte_offset } } buf ->
+        Memory_stubs.Pointer.write ~offset
+          Ctypes_raw.PtrType.(add raw_ptr (of_int pbyte_offset)) buf)
+    | Bigarray b ->
+      (fun ~offset v buf ->
+        Memory_stubs.Pointer.write ~offset (Ctypes_bigarray.address b v) buf)
+    | View { write; ty } ->
+      let write_ty = write_arg ty in
+      (fun ~offset v buf -> write_ty ~offset (write v) buf)
+    | ty -> Memory.write ty
+
+  (* Read an argument passed to a callback.  Array and bigarray arguments are
+     read as views of the memory at the address passed. *)
+  let rec read_arg : type a. a typ -> offset:int -> Ctypes_raw.voidp -> a
+    = function
+    | Array (ty, n, _) ->
+      (fun ~offset buf ->
+        Memory.CArray.from_ptr
+          { reftype = ty; pmanaged = None; pbyte_offset = 0;
+            raw_ptr = Memory_stubs.Pointer.read ~offset buf } n)
+    | Bigarray b ->
+      (fun ~offset buf ->
+        Ctypes_bigarray.view b (Memory_stubs.Pointer.read ~offset buf) ~offset:0)
+    | View { read; ty } ->
+      let read_ty = read_arg ty in
+      (fun ~offset buf -> read (read_ty ~offset buf))
+    | ty -> Memory.build ty
+
   let prep_callspec callspec abi ty =
     let ArgType ctype = arg_type ty in
     Ffi_stubs.prep_callspec callspec (abi_code abi) ctype
@@ -126,7 +177,7 @@ struct
       | Function (p, f) ->
         let _ = add_argument callspec p in
         let box = box_function abi f callspec in
-        let read = Memory.build p ~offset:0 in
+        let read = read_arg p ~offset:0 in
         fun f -> Ffi_stubs.Fn (fun buf ->
           let f' = 
             try WeakRef.get f (read buf) 
@@ -154,7 +205,7 @@ struct
       | Function (p, f) ->
         let offset = add_argument callspec p in
         let rest = build_ccallspec ~abi ~check_errno f callspec in
-        WriteArg (Memory.write p ~offset, rest)
+        WriteArg (write_arg p ~offset, rest)
 
   let build_function ?name ~abi ~check_errno fn =
     let c = Ffi_stubs.allocate_callspec () in
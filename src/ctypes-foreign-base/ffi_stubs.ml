@@ -87,6 +87,6 @@ let () = Callback.register_exception "FFI_internal_error"
 
 (* A closure passed to C was collected by the OCaml garbage collector before
    it was called. *)
-exception CallToExpiredClosure
+exception CallToExpiredClosure = Static.CallToExpiredClosure
 let () = Callback.register_exception "CallToExpiredClosure"
   CallToExpiredClosure
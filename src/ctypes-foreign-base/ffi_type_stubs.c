@@ -76,6 +76,9 @@ static ffi_type *primitive_ffi_types[] = {
   &ffi_type_double,         /* Double */
   NULL,                     /* Complex32 */
   NULL,                     /* Complex64 */
+  &ffi_type_slong,          /* Long_as_int */
+  &ctypes_ffi_type_sllong,  /* Llong_as_int */
+  &ctypes_ffi_type_size_t,  /* Size_t_as_int */
 };
 
 
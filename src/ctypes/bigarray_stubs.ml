@@ -38,6 +38,18 @@ external view : 'a kind -> dims:int array -> Ctypes_raw.voidp -> offset:int ->
   ('a, 'b, Bigarray.c_layout) Bigarray.Genarray.t
   = "ctypes_bigarray_view"
 
+external view_with_layout : 'a kind -> 'l Bigarray.layout -> dims:int array ->
+  Ctypes_raw.voidp -> offset:int -> ('a, 'b, 'l) Bigarray.Genarray.t
+  (* Bigarray.layout is represented as an int: the index of the layout
+     from OCaml 4.02, and the value of its flag in caml/bigarray.h before.
+     The stub converts it with Caml_ba_layout_val. *)
+  = "ctypes_bigarray_view_with_layout"
+
+(* Make the bigarray share ownership of the memory of [src], if [src] is a
+   managed buffer, returning [false] if the memory cannot be shared. *)
+external share_storage : 'b -> Obj.t -> bool
+  = "ctypes_bigarray_share_storage"
+
 external view1 : 'a kind -> dims:int array -> Ctypes_raw.voidp -> offset:int ->
   ('a, 'b, Bigarray.c_layout) Bigarray.Array1.t
   = "ctypes_bigarray_view"
@@ -0,0 +1,88 @@
+(*
+ * Copyright (c) 2014 Jeremy Yallop.
+ *
+ * This file is distributed under the terms of the MIT License.
+ * See the file LICENSE for details.
+ *)
+
+open Static
+open Memory
+
+type ('r, 'k, 's) members =
+  | Done : ('r, 'r, 's) members
+  | Member : ('a, 's) field * ('r -> 'a) * ('r, 'k, 's) members ->
+    ('r, 'a -> 'k, 's) members
+
+type ('r, 's) t = {
+  ctype: 's typ;
+  size: int;
+  encoder: 'r -> offset:int -> Raw.voidp -> unit;
+  decoder: offset:int -> Raw.voidp -> 'r;
+}
+
+(* Fields are read by value: aggregates other than structs have no
+   representation that is independent of the C array. *)
+let rec check_member : type a. a typ -> unit = function
+  | Union _ -> raise (Unsupported "codec member of union type")
+  | Array _ -> raise (Unsupported "codec member of array type")
+  | Bigarray _ -> raise (Unsupported "codec member of bigarray type")
+  | Abstract _ -> raise (Unsupported "codec member of abstract type")
+  | View { ty } -> check_member ty
+  | _ -> ()
+
+let rec encoder : type r k s. (r, k, s) members ->
+  (r -> offset:int -> Raw.voidp -> unit) = function
+  | Done -> fun _ ~offset _ -> ()
+  | Member ({ ftype; foffset }, get, rest) ->
+    let () = check_member ftype in
+    let write = write ftype and rest = encoder rest in
+    fun r ~offset buf ->
+      write ~offset:(offset + foffset) (get r) buf;
+      rest r ~offset buf
+
+let rec decoder : type r k s. (r, k, s) members ->
+  (k -> offset:int -> Raw.voidp -> r) = function
+  | Done -> fun k ~offset _ -> k
+  | Member ({ ftype; foffset }, _, rest) ->
+    let () = check_member ftype in
+    let read = build ftype and rest = decoder rest in
+    fun k ~offset buf -> rest (k (read ~offset:(offset + foffset) buf)) ~offset buf
+
+let create ctype ~make members =
+  let decode = decoder members in
+  { ctype;
+    size = sizeof ctype;
+    encoder = encoder members;
+    decoder = fun ~offset buf -> decode make ~offset buf }
+
+let encode { ctype; size; encoder } records =
+  let arr = CArray.make ctype (Array.length records) in
+  let { raw_ptr; pbyte_offset } = CArray.start arr in
+  Array.iteri
+    (fun i r -> encoder r ~offset:(pbyte_offset + i * size) raw_ptr)
+    records;
+  arr
+
+let encode_list { ctype; size; encoder } records =
+  let arr = CArray.make ctype (List.length records) in
+  let { raw_ptr; pbyte_offset } = CArray.start arr in
+  List.iteri
+    (fun i r -> encoder r ~offset:(pbyte_offset + i * size) raw_ptr)
+    records;
+  arr
+
+(* The closures refer to [arr] rather than to its address, which keeps the
+   array alive while records are allocated. *)
+let decode { size; decoder } arr =
+  Array.init (CArray.length arr)
+    (fun i ->
+      let { raw_ptr; pbyte_offset } = CArray.start arr in
+      decoder ~offset:(pbyte_offset + i * size) raw_ptr)
+
+let decode_list { size; decoder } arr =
+  let rec loop i acc =
+    if i < 0 then acc
+    else
+      let { raw_ptr; pbyte_offset } = CArray.start arr in
+      loop (i - 1) (decoder ~offset:(pbyte_offset + i * size) raw_ptr :: acc)
+  in loop (CArray.length arr - 1) []
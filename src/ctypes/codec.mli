@@ -0,0 +1,23 @@
+(*
+ * Copyright (c) 2014 Jeremy Yallop.
+ *
+ * This file is distributed under the terms of the MIT License.
+ * See the file LICENSE for details.
+ *)
+
+(* Bulk conversion between OCaml records and arrays of C structs. *)
+
+type ('r, 'k, 's) members =
+  | Done : ('r, 'r, 's) members
+  | Member : ('a, 's) Static.field * ('r -> 'a) * ('r, 'k, 's) members ->
+    ('r, 'a -> 'k, 's) members
+
+type ('r, 's) t
+
+val create : ((_, [`Struct]) Static.structured as 's) Static.typ -> make:'k ->
+  ('r, 'k, 's) members -> ('r, 's) t
+
+val encode : ('r, 's) t -> 'r array -> 's Static.carray
+val encode_list : ('r, 's) t -> 'r list -> 's Static.carray
+val decode : ('r, 's) t -> 's Static.carray -> 'r array
+val decode_list : ('r, 's) t -> 's Static.carray -> 'r list
@@ -19,6 +19,12 @@ include Value_printing
 
 include Coerce
 
+module Codec = Codec
+
+module Layout = Layout
+
+module Type_id = Type_id
+
 let ( *:* ) s t = field s "<unknown>" t
 
 let ( +:+ ) s t = field s "<unknown>" t
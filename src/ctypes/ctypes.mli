@@ -150,6 +150,25 @@ val complex32 : Complex.t typ
 val complex64 : Complex.t typ
 (** Value representing the C99 double-precision [double complex] type. *)
 
+(** {5 Integer types represented as OCaml [int]}
+
+    The following values represent the same C types as {!long}, {!llong} and
+    {!size_t}, but read and write them as OCaml [int] values rather than as
+    boxed {!Signed.long}, {!Signed.llong} and {!Unsigned.size_t} values, so
+    that accessing them does not allocate.  Reading a C value that does not
+    fit in an OCaml [int] raises [Failure]; writing an OCaml [int] that does
+    not fit in the C type raises [Invalid_argument]. *)
+
+val long_as_int : int typ
+(** Value representing the C type ([signed]) [long] as an OCaml [int]. *)
+
+val llong_as_int : int typ
+(** Value representing the C type ([signed]) [long long] as an OCaml
+    [int]. *)
+
+val size_t_as_int : int typ
+(** Value representing the C type [size_t] as an OCaml [int]. *)
+
 (** {4:pointer_types Pointer types} *)
 
 type 'a ptr = 'a Static.ptr
@@ -261,6 +280,13 @@ val ( @-> ) : 'a typ -> 'b fn -> ('a -> 'b) fn
 
     describes a function type that accepts two arguments -- an integer and a
     pointer to void -- and returns a float.
+
+    As in C, a parameter of array type is passed as a pointer to the first
+    element: an {!array} argument passes the address of the first element of
+    the C array, and a {!bigarray} argument passes the address of the
+    bigarray data, in each case directly, without copying.  The length of the
+    array and the dimensions in the bigarray type are not checked against
+    the argument.
 *)
 
 val returning : 'a typ -> 'a fn
@@ -281,16 +307,24 @@ type 'a structure = ('a, [`Struct]) structured
 type 'a union = ('a, [`Union]) structured
 (** The type of values representing C union types. *)
 
-type ('a, 't) field
+type ('a, 't) field = ('a, 't) Static.field
 (** The type of values representing C struct or union members (called "fields"
     here).  A value of type [(a, s) field] represents a field of type [a] in a
     struct or union of type [s]. *)
 
-val structure : string -> 's structure typ
+val structure : ?packed:bool -> ?pack:int -> string -> 's structure typ
 (** Construct a new structure type.  The type value returned is incomplete and
     can be updated using {!(*:*)} until it is passed to {!seal}, at which point
     the set of fields is fixed.
 
+    The optional arguments describe packed layouts.  [~packed:true]
+    corresponds to [__attribute__((packed))]: fields lose their natural
+    alignment, but keep any alignment requested with [field ~align].
+    [~pack:n] corresponds to [#pragma pack(n)]: the alignment of every field,
+    including requested alignments, is limited to [n], which must be a power
+    of two.  Fields of packed structures may be unaligned; they can be read
+    and written with {!getf} and {!setf} as usual.
+
     The type (['_s structure typ]) of the expression returned by the call
     [structure tag] includes a weak type variable, which can be explicitly
     instantiated to ensure that the OCaml values representing different C
@@ -301,20 +335,59 @@ val structure : string -> 's structure typ
     [let tagname : tagname structure typ = structure "tagname"]
 *)
 
-val union : string -> 's union typ
+val union : ?packed:bool -> ?pack:int -> string -> 's union typ
 (** Construct a new union type.  This behaves analogously to {!structure};
     fields are added with {!(+:+)}. *)
 
-val field : 't typ -> string -> 'a typ ->
+val field : ?align:int -> 't typ -> string -> 'a typ ->
   ('a, (('s, [<`Struct | `Union]) structured as 't)) field
 (** [field ty label ty'] adds a field of type [ty'] with label [label] to the
     structure or union type [ty] and returns a field value that can be used to
     read and write the field in structure or union instances (e.g. using
     {!getf} and {!setf}).
 
+    The optional argument [align] corresponds to
+    [__attribute__((aligned(align)))] on the member: it increases the
+    alignment of the field to [align], which must be a power of two.
+
     Attempting to add a field to a union type that has been sealed with [seal]
     is an error, and will raise {!ModifyingSealedType}. *)
 
+type ('a, 't) bitfield
+(** The type of values representing C bitfield members of struct or union
+    types.  A value of type [(a, s) bitfield] represents a bitfield whose
+    declared type is [a] in a struct or union of type [s]. *)
+
+val bitfield : 't typ -> string -> width:int -> 'a typ ->
+  ('a, (('s, [<`Struct | `Union]) structured as 't)) bitfield
+(** [bitfield ty label ~width ty'] adds a bitfield of [width] bits with
+    declared type [ty'] and label [label] to the structure or union type
+    [ty], corresponding to the C declaration [ty' label : width].  The
+    declared type must be an integer type or a view of an integer type.
+
+    Bitfields are laid out following the platform's C ABI: adjacent bitfields
+    share a storage unit of the declared type where they fit, and a bitfield of
+    width [0] pads the structure to the next storage unit.  The values returned
+    by {!bitfield} are used with {!getbf} and {!setbf}.
+
+    Raises [Invalid_argument] if [width] is negative or exceeds the number of
+    bits in [ty'], and {!Unsupported} if [ty'] is not an integer type. *)
+
+type ('a, 't) flexible
+(** The type of values representing flexible array members of struct types.
+    A value of type [(a, s) flexible] represents a trailing member with
+    element type [a] in a struct of type [s]. *)
+
+val flexible_array : 't typ -> string -> 'a typ ->
+  ('a, (('s, [`Struct]) structured as 't)) flexible
+(** [flexible_array ty label ty'] adds a flexible array member with element
+    type [ty'] and label [label] to the structure type [ty], corresponding to
+    the C declaration [ty' label[]].  The flexible array member must be the
+    last member of the structure, and does not contribute to its size.
+
+    Raises {!Unsupported} if [ty] has no other members or if further members
+    are added to [ty] after the flexible array member. *)
+
 val ( *:* ) : 't typ -> 'a typ -> ('a, (('s, [`Struct]) structured as 't)) field
 (** @deprecated Add an anonymous field to a structure.  Use {!field} instead. *)
 
@@ -327,6 +400,72 @@ val seal : (_, [< `Struct | `Union]) structured typ -> unit
     in a way that involves their size or alignment; see the documentation for
     {!IncompleteType} for further details.  *)
 
+(** {3 Layout analysis} *)
+
+module Layout :
+sig
+  type member = {
+    name : string;
+    (** The name of the member. *)
+    decl : string;
+    (** The C declaration of the member, e.g. ["int x[3]"]. *)
+    offset : int;
+    (** The offset of the first byte of the member. *)
+    size : int;
+    (** The number of bytes occupied by the member, including any partially
+        occupied bytes of a bitfield. *)
+    align : int;
+    (** The alignment of the member, taking packing into account. *)
+    bits : (int * int) option;
+    (** For bitfields, the position of the first bit within the byte at
+        [offset] and the width in bits. *)
+  }
+  (** The placement of a struct or union member. *)
+
+  type hole = { hole_offset : int; hole_size : int }
+  (** A range of padding bytes that belongs to no member. *)
+
+  type t = {
+    kind : [`Struct | `Union];
+    tag : string;
+    size : int;
+    align : int;
+    members : member list;
+    (** The members in declaration order.  Zero-width bitfields are omitted. *)
+    holes : hole list;
+    (** The padding between members and after the last member, in order. *)
+    wasted : int;
+    (** The total number of padding bytes. *)
+    cache_line : int;
+    straddling : member list;
+    (** The members that cross a cache line boundary, assuming that the
+        struct or union begins at the start of a cache line. *)
+    suggested_order : string list;
+    (** An order of the members that minimises padding.  Members are ordered
+        by decreasing alignment and then decreasing size; runs of adjacent
+        bitfields are kept together.  For unions, and for structs that
+        cannot be improved, this is the declaration order. *)
+    suggested_size : int;
+    (** The size of the struct when its members are in the suggested
+        order. *)
+  }
+  (** A description of the layout of a struct or union type. *)
+
+  val analyse : ?cache_line:int -> (_, _) structured typ -> t
+  (** [analyse t] describes the layout of the struct or union type [t].  The
+      optional argument [cache_line] gives the size in bytes of a cache line,
+      and defaults to [64].
+
+      Raises {!IncompleteType} if [t] has not been sealed. *)
+
+  val format : Format.formatter -> t -> unit
+  (** Pretty-print a layout description as an annotated C declaration, in the
+      style of [pahole]. *)
+
+  val to_string : t -> string
+  (** Return the output of {!format} as a string. *)
+end
+
 (** {3 View types} *)
 
 val view : ?format_typ:((Format.formatter -> unit) -> Format.formatter -> unit) ->
@@ -396,6 +535,61 @@ val string_of_typ : ?name:string -> 'a typ -> string
 val string_of_fn : ?name:string -> 'a fn -> string
 (** Return a C representation of the function type. *)
 
+(** {3 Type identity} *)
+
+module Type_id :
+sig
+  type t
+  (** The canonical descriptor of a type or function type.  Descriptors are
+      hash-consed: two types have equal descriptors exactly when they are
+      built in the same way from the same primitive types, structs, unions
+      and views, so descriptors can be compared and hashed in constant time
+      and used as keys in tables of data associated with types.
+
+      Struct and union types are identified by their tags and layouts, and
+      by their tags alone when reached through a pointer, so that recursive
+      types have descriptors.  View types are identified by identity: each
+      call to {!view} creates a type with a distinct descriptor.
+
+      Descriptors are held weakly by the interning tables, and are collected
+      once no type value or other reachable value refers to them.  Interning
+      is not thread-safe: computing descriptors of the same type in several
+      threads at once may give descriptors that are not {!equal}. *)
+
+  val of_typ : 'a typ -> t
+  (** Compute the descriptor of a type.  The descriptors of array and view
+      types are cached, so repeated calls take constant time for those
+      types.  The exception {!IncompleteType} is raised if the type is an
+      incomplete struct or union. *)
+
+  val of_fn : 'a fn -> t
+  (** Compute the descriptor of a function type. *)
+
+  val id : t -> int
+  (** An integer that identifies the descriptor within the running
+      program.  If every descriptor for a type has been collected, computing
+      the descriptor again gives a new id, so ids should be used as keys
+      only while the descriptor itself is kept reachable. *)
+
+  val fingerprint : t -> int64
+  (** A 64-bit hash of the C type denoted by the descriptor, which does not
+      vary between runs of the program.  Views have the fingerprint of the
+      underlying type.  Fingerprints are not guaranteed to be distinct. *)
+
+  val representation : t -> int64
+  (** A 64-bit hash like {!fingerprint} that also distinguishes the OCaml
+      representations of a function's arguments and result: a view differs
+      from its underlying type, though not from other views of that type,
+      and an integer type read as an OCaml [int] differs from the type
+      itself.  Code that converts between C and OCaml values for a function
+      type may be shared between function types with the same
+      representation. *)
+
+  val equal : t -> t -> bool
+  val compare : t -> t -> int
+  val hash : t -> int
+end
+
 (** {2:values Values representing C values} *)
 
 val format : 'a typ -> Format.formatter -> 'a -> unit
@@ -552,6 +746,54 @@ val bigarray_of_ptr : < element: 'a;
     'i -> ('a, 'f) Bigarray.kind -> 'a ptr -> 'b
 (** Convert a C pointer to a bigarray value. *)
 
+val genarray_of_ptr : 'l Bigarray.layout -> int array ->
+  ('a, 'b) Bigarray.kind -> 'a ptr -> ('a, 'b, 'l) Bigarray.Genarray.t
+(** [genarray_of_ptr layout dims kind p] views the memory at [p] as a
+    bigarray with the given layout and dimensions, without copying.
+
+    In [Bigarray.fortran_layout] the first index varies fastest, as in
+    Fortran and in column-major libraries such as LAPACK; in particular,
+    an [m]-by-[n] C array of rows viewed with dimensions [[|n; m|]] in
+    Fortran layout is its transpose.  The functions
+    [Bigarray.array1_of_genarray], [Bigarray.array2_of_genarray] and
+    [Bigarray.array3_of_genarray] convert the result to a bigarray of fixed
+    dimension, and the [sub] and [slice] functions of [Bigarray.Genarray]
+    give contiguous sub-views of it, also without copying: [sub_left] and
+    [slice_left] select rows in C layout, and [sub_right] and [slice_right]
+    select columns in Fortran layout.
+
+    Bigarrays describe only contiguous memory, so a column of a matrix in
+    C layout, or a row of a matrix in Fortran layout, cannot be viewed in
+    place; {!gather_strided} and {!scatter_strided} copy such a strided
+    row or column in a single pass.
+
+    Raises [Invalid_argument] if there are more than 16 dimensions or a
+    dimension is negative. *)
+
+val genarray_start : ('a, _, _) Bigarray.Genarray.t -> 'a ptr
+(** Return the address of the first element of a bigarray of any layout.
+    Unlike {!bigarray_start}, this function also accepts bigarrays in
+    [Bigarray.fortran_layout]. *)
+
+val gather_strided : 'a ptr -> stride:int ->
+  ('a, _, _) Bigarray.Array1.t -> unit
+(** [gather_strided p ~stride ba] copies the elements at [p],
+    [p +@ stride], [p +@ 2 * stride], ... into successive elements of
+    [ba], reading [Bigarray.Array1.dim ba] elements.  For example, column
+    [j] of an [m]-by-[n] matrix [a] in C layout, or row [j] of an [n]-by-[m]
+    matrix in Fortran layout, is copied into a bigarray [col] of length [m]
+    by [gather_strided (genarray_start a +@ j) ~stride:n col].
+
+    Raises [Invalid_argument] if [stride] is not positive, and
+    {!Unsupported} if the elements of [ba] do not have the size and
+    representation of the type of [p]. *)
+
+val scatter_strided : ('a, _, _) Bigarray.Array1.t -> 'a ptr -> stride:int ->
+  unit
+(** [scatter_strided ba p ~stride] copies the elements of [ba] to [p],
+    [p +@ stride], [p +@ 2 * stride], ....  This is the inverse of
+    {!gather_strided}. *)
+
 val array_of_bigarray : < element: _;
                           ba_repr: _;
                           bigarray: 'b;
@@ -567,6 +809,19 @@ val bigarray_of_array : < element: 'a;
     ('a, 'f) Bigarray.kind -> 'c carray -> 'b
 (** Convert a C array to a Bigarray value. *)
 
+val allocate_bigarray : < element: 'a;
+                          ba_repr: 'f;
+                          bigarray: 'b;
+                          carray: 'c;
+                          dims: 'dims > bigarray_class ->
+    'dims -> ('a, 'f) Bigarray.kind -> 'b * 'c
+(** [allocate_bigarray c dims k] allocates a single block of fresh,
+    uninitialised C memory with dimensions [dims] and element kind [k], and
+    returns it both as a Bigarray and as a C array.  The memory is owned by
+    the Bigarray, and is freed when neither the Bigarray nor any C array or
+    pointer derived from it is reachable, so no finaliser or copying is
+    involved in passing it between ctypes and Bigarray-based libraries. *)
+
 
 (** {3 Struct and union values} *)
 
@@ -584,6 +839,30 @@ val getf : ((_, _) structured as 's) -> ('a, 's) field -> 'a
     [s].  The semantics for non-scalar types are non-copying, as for
     {!(!@)}.*)
 
+val setbf : ((_, _) structured as 's) -> ('a, 's) bitfield -> 'a -> unit
+(** [setbf s f v] overwrites the value of the bitfield [f] in the structure or
+    union [s] with the low-order bits of [v], leaving the other bits of the
+    storage unit unchanged. *)
+
+val getbf : ((_, _) structured as 's) -> ('a, 's) bitfield -> 'a
+(** [getbf s f] retrieves the value of the bitfield [f] in the structure or
+    union [s].  Bitfields of signed type are sign-extended. *)
+
+val make_flexible : ?finalise:('s -> unit) -> ((_, [`Struct]) structured as 's) typ ->
+  ('a, 's) flexible -> count:int -> 's
+(** [make_flexible t f ~count] allocates a fresh, uninitialised structure
+    value of type [t] together with [count] trailing elements of the flexible
+    array member [f] in a single block of memory.  The argument [?finalise],
+    if present, will be called just before the underlying memory is freed. *)
+
+val getflex : ((_, [`Struct]) structured as 's) -> ('a, 's) flexible ->
+  length:int -> 'a carray
+(** [getflex s f ~length] returns the first [length] elements of the
+    flexible array member [f] of the structure [s] as a C array.  The
+    semantics are non-copying, as for {!getf}.  It is the caller's
+    responsibility to ensure that [s] has at least [length] trailing
+    elements. *)
+
 val (@.) : ((_, _) structured as 's) -> ('a, 's) field -> 'a ptr
 (** [s @. f] computes the address of the field [f] in the structure or union
     value [s]. *)
@@ -602,6 +881,132 @@ val field_type : ('a, _) field -> 'a typ
 val addr : ((_, _) structured as 's) -> 's ptr
 (** [addr s] returns the address of the structure or union [s]. *)
 
+(** {4 Columnar access to arrays of structs} *)
+
+type 's column =
+  Column : ('a, 's) field * ('b, 'c, Bigarray.c_layout) Bigarray.Array1.t ->
+    's column
+(** A field of a struct type paired with a one-dimensional bigarray that
+    holds the value of the field for each element of an array of structs.
+    The field must have primitive type, and the bigarray elements must have
+    the same size and representation as the field: for example, an [int32_t]
+    field may be paired with an [int32] bigarray and a [double] field with a
+    [float64] bigarray. *)
+
+val gather : (_ structure as 's) carray -> 's column list -> unit
+(** [gather a cols] copies the fields of the elements of [a] into the
+    corresponding columns [cols], in a single pass over [a].
+
+    Raises [Invalid_argument] if the length of any column differs from the
+    length of [a], and {!Unsupported} if a column does not match its field.
+*)
+
+val scatter : 's column list -> (_ structure as 's) carray -> unit
+(** [scatter cols a] copies the columns [cols] into the corresponding fields
+    of the elements of [a], in a single pass over [a].  This is the inverse of
+    {!gather}. *)
+
+(** {4 Element-wise operations on arrays of unsigned 64-bit integers} *)
+
+module UInt64_array :
+sig
+  type t = Unsigned.uint64 carray
+  (** Arrays of [uint64_t] values.
+
+      The operations in this module act on every element of their arguments
+      in a single loop in C, without allocating.  Each operation stores its
+      result in the array [dst], which may be the same array as one of the
+      operands.  Every operation raises [Invalid_argument] if the lengths of
+      the arrays differ. *)
+
+  val of_bigarray :
+    (int64, Bigarray.int64_elt, Bigarray.c_layout) Bigarray.Array1.t -> t
+  (** [of_bigarray b] is an array that shares the storage of the bigarray
+      [b], whose elements are read as unsigned. *)
+
+  val add : dst:t -> t -> t -> unit
+  (** Element-wise addition, modulo 2{^64}. *)
+
+  val sub : dst:t -> t -> t -> unit
+  (** Element-wise subtraction, modulo 2{^64}. *)
+
+  val mul : dst:t -> t -> t -> unit
+  (** Element-wise multiplication, modulo 2{^64}. *)
+
+  val logand : dst:t -> t -> t -> unit
+  (** Element-wise bitwise logical and. *)
+
+  val logor : dst:t -> t -> t -> unit
+  (** Element-wise bitwise logical or. *)
+
+  val logxor : dst:t -> t -> t -> unit
+  (** Element-wise bitwise logical exclusive or. *)
+
+  val equal_mask : dst:t -> t -> t -> unit
+  (** [equal_mask ~dst a b] sets each element of [dst] to
+      {!Unsigned.UInt64.max_int} where the corresponding elements of [a] and
+      [b] are equal, and to zero elsewhere. *)
+
+  val less_mask : dst:t -> t -> t -> unit
+  (** [less_mask ~dst a b] sets each element of [dst] to
+      {!Unsigned.UInt64.max_int} where the element of [a] is less than the
+      corresponding element of [b], and to zero elsewhere. *)
+
+  val shift_left : dst:t -> t -> int -> unit
+  (** [shift_left ~dst a n] shifts each element of [a] left by [n] bits.
+      Raises [Invalid_argument] unless [0 <= n < 64]. *)
+
+  val shift_right : dst:t -> t -> int -> unit
+  (** [shift_right ~dst a n] shifts each element of [a] right by [n] bits,
+      filling with zeros.  Raises [Invalid_argument] unless [0 <= n < 64]. *)
+end
+(** Bulk arithmetic on arrays of [uint64_t] values. *)
+
+(** {4 Conversions between OCaml records and arrays of structs} *)
+
+module Codec :
+sig
+  type ('r, 'k, 's) members =
+    | Done : ('r, 'r, 's) members
+    | Member : ('a, 's) field * ('r -> 'a) * ('r, 'k, 's) members ->
+      ('r, 'a -> 'k, 's) members
+  (** A mapping between the fields of an OCaml record type ['r] and the
+      fields of a C struct type ['s].  Each [Member (f, get, ms)] pairs the
+      struct field [f] with the function [get] that projects the
+      corresponding value from a record; the type ['k] is the type of a
+      function that builds a record from the values of the members, in order.
+
+      Conversions between the OCaml and C representations of a member are
+      given by the type of its field, which may be a {!view}. *)
+
+  type ('r, 's) t
+  (** A compiled encoder and decoder between values of the OCaml record type
+      ['r] and the C struct type ['s]. *)
+
+  val create : (_ structure as 's) typ -> make:'k -> ('r, 'k, 's) members ->
+    ('r, 's) t
+  (** [create t ~make ms] compiles the mapping [ms] between records and the
+      struct type [t].  The function [make] builds a record from the values of
+      the members of [ms].  The readers and writers for each member are
+      computed once, when the codec is created.
+
+      Raises {!Unsupported} if a member has union, array, bigarray or abstract
+      type. *)
+
+  val encode : ('r, 's) t -> 'r array -> 's carray
+  (** [encode c rs] allocates a C array of structs and writes the members of
+      each record of [rs] into the corresponding element. *)
+
+  val encode_list : ('r, 's) t -> 'r list -> 's carray
+  (** [encode_list c rs] behaves as [encode c (Array.of_list rs)]. *)
+
+  val decode : ('r, 's) t -> 's carray -> 'r array
+  (** [decode c a] reads a record from each element of the C array [a]. *)
+
+  val decode_list : ('r, 's) t -> 's carray -> 'r list
+  (** [decode_list c a] behaves as [Array.to_list (decode c a)]. *)
+end
+
 (** {3 Coercions} *)
 
 val coerce : 'a typ -> 'b typ -> 'a -> 'b
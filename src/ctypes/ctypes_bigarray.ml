@@ -132,10 +132,30 @@ let type_expression : type a b. (a, b) t -> _ =
           | `Appl of Ctypes_path.path * 'a list ] as 'a)
   end
 
+let descriptor : type a b. (a, b) t -> string =
+  fun ((d, k) as t) ->
+    let cls = match d with
+      | DimsGen _ -> "Genarray"
+      | Dims1 _ -> "Array1"
+      | Dims2 _ -> "Array2"
+      | Dims3 _ -> "Array3" in
+    Printf.sprintf "%s(%s)[%s]" cls (string_of_kind k)
+      (String.concat "," (List.map string_of_int (Array.to_list (dimensions t))))
+
 let prim_of_kind k = prim_of_kind (kind k)
 
 let address _ b = Bigarray_stubs.address b
 
+(* A view shares ownership of managed memory through the bigarray's proxy,
+   which costs nothing at collection time.  Other references are kept alive
+   by a finaliser on the view. *)
+let keep_alive ?ref ba = match ref with
+  | None -> ba
+  | Some src ->
+    if not (Bigarray_stubs.share_storage ba src) then
+      Gc.finalise (fun _ -> ignore src; ()) ba;
+    ba
+
 let view : type a b. (a, b) t -> ?ref:Obj.t -> Ctypes_raw.voidp -> offset:int -> b =
   let open Bigarray_stubs in
   fun (dims, kind) ?ref ptr ~offset -> let ba : b = match dims with
@@ -143,6 +163,8 @@ let view : type a b. (a, b) t -> ?ref:Obj.t -> Ctypes_raw.voidp -> offset:int ->
   | Dims1 d -> view1 kind [| d |] ptr offset
   | Dims2 (d1, d2) -> view2 kind [| d1; d2 |] ptr offset
   | Dims3 (d1, d2, d3) -> view3 kind [| d1; d2; d3 |] ptr offset in
-  match ref with
-  | None -> ba
-  | Some src -> Gc.finalise (fun _ -> ignore src; ()) ba; ba
+  keep_alive ?ref ba
+
+let genarray_view layout dims k ?ref ptr ~offset =
+  keep_alive ?ref
+    (Bigarray_stubs.view_with_layout (kind k) layout dims ptr offset)
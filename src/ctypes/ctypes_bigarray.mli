@@ -46,6 +46,10 @@ val element_type : ('a, _) t -> 'a Primitives.prim
 val dimensions : (_, _) t -> int array
 (** Compute the dimensions of a bigarray type. *)
 
+val descriptor : (_, _) t -> string
+(** Compute a string that identifies a bigarray type by its class, element
+    kind and dimensions. *)
+
 val type_expression : ('a, 'b) t -> ([> `Appl of Ctypes_path.path * 'c list
                                      |  `Ident of Ctypes_path.path ] as 'c)
 (** Compute a type expression that denotes a bigarray type. *)
@@ -61,3 +65,8 @@ val view : (_, 'a) t -> ?ref:Obj.t -> Ctypes_raw.voidp -> offset:int -> 'a
     The optional [ref] argument is an OCaml object that controls the lifetime
     of the memory; if [ref] is present, [view] will ensure that it is not
     collected before the bigarray returned by [view]. *)
+
+val genarray_view : 'l Bigarray.layout -> int array -> ('a, 'b) Bigarray.kind ->
+  ?ref:Obj.t -> Ctypes_raw.voidp -> offset:int -> ('a, 'b, 'l) Bigarray.Genarray.t
+(** Create a bigarray view with the given layout and dimensions onto
+    existing contiguous memory.  The [ref] argument is as for {!view}. *)
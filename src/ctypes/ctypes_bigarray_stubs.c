@@ -9,6 +9,13 @@
 #include <caml/bigarray.h>
 
 #include "raw_pointer.h"
+#include "managed_buffer_stubs.h"
+
+/* Bigarray.layout is a GADT from OCaml 4.02, whose values are 0 and 1;
+   earlier versions represent each layout by its flag. */
+#ifndef Caml_ba_layout_val
+#define Caml_ba_layout_val(v) (Int_val(v) & CAML_BA_LAYOUT_MASK)
+#endif
 
 /* address : 'b -> pointer */
 value ctypes_bigarray_address(value ba)
@@ -16,11 +23,8 @@ value ctypes_bigarray_address(value ba)
   return CTYPES_FROM_PTR(Caml_ba_data_val(ba));
 }
 
-/* _view : ('a, 'b) kind -> dims:int array -> ptr -> offset:int ->
-           ('a, 'b, Bigarray.c_layout) Bigarray.Genarray.t */
-value ctypes_bigarray_view(value kind_, value dims_, value ptr_, value offset_)
+static value view(int kind, int layout, value dims_, value ptr_, value offset_)
 {
-  int kind = Int_val(kind_);
   int ndims = Wosize_val(dims_);
   int offset = Int_val(offset_);
   intnat dims[CAML_BA_MAX_NUM_DIMS];
@@ -28,7 +32,37 @@ value ctypes_bigarray_view(value kind_, value dims_, value ptr_, value offset_)
   for (i = 0; i < ndims; i++) {
     dims[i] = Int_val(Field(dims_, i));
   }
-  int flags = kind | CAML_BA_C_LAYOUT | CAML_BA_EXTERNAL;
+  int flags = kind | layout | CAML_BA_EXTERNAL;
   void *data = offset + (char *)CTYPES_TO_PTR(ptr_);
   return caml_ba_alloc(flags, ndims, data, dims);
 }
+
+/* _view : ('a, 'b) kind -> dims:int array -> ptr -> offset:int ->
+           ('a, 'b, Bigarray.c_layout) Bigarray.Genarray.t */
+value ctypes_bigarray_view(value kind_, value dims_, value ptr_, value offset_)
+{
+  return view(Int_val(kind_), CAML_BA_C_LAYOUT, dims_, ptr_, offset_);
+}
+
+/* view_with_layout : ('a, 'b) kind -> 'l Bigarray.layout -> dims:int array ->
+                      ptr -> offset:int -> ('a, 'b, 'l) Bigarray.Genarray.t */
+value ctypes_bigarray_view_with_layout(value kind_, value layout_, value dims_,
+                                       value ptr_, value offset_)
+{
+  return view(Int_val(kind_), Caml_ba_layout_val(layout_),
+              dims_, ptr_, offset_);
+}
+
+/* share_storage : 'b -> Obj.t -> bool */
+value ctypes_bigarray_share_storage(value ba, value src)
+{
+  struct caml_ba_array *b = Caml_ba_array_val(ba);
+  struct caml_ba_proxy *proxy = ctypes_managed_buffer_proxy(src);
+  if (proxy == NULL)
+    return Val_false;
+  /* The runtime releases the memory when the last bigarray or buffer that
+     refers to the proxy is collected. */
+  b->flags = (b->flags & ~CAML_BA_MANAGED_MASK) | CAML_BA_MANAGED;
+  b->proxy = proxy;
+  return Val_true;
+}
@@ -0,0 +1,167 @@
+(*
+ * Copyright (c) 2014 Jeremy Yallop.
+ *
+ * This file is distributed under the terms of the MIT License.
+ * See the file LICENSE for details.
+ *)
+
+(* Analysis of the layout of struct and union types. *)
+
+type member = {
+  name : string;
+  decl : string;
+  offset : int;
+  size : int;
+  align : int;
+  bits : (int * int) option;
+}
+
+type hole = { hole_offset : int; hole_size : int }
+
+type t = {
+  kind : [`Struct | `Union];
+  tag : string;
+  size : int;
+  align : int;
+  members : member list;
+  holes : hole list;
+  wasted : int;
+  cache_line : int;
+  straddling : member list;
+  suggested_order : string list;
+  suggested_size : int;
+}
+
+let aligned_offset offset alignment =
+  match offset mod alignment with
+    0 -> offset
+  | overhang -> offset - overhang + alignment
+
+let members_of_fields packing fields =
+  List.fold_right
+    (fun field members -> match field with
+    | Static.BoxedField { Static.ftype; foffset; fname; falign } ->
+      { name = fname;
+        decl = Type_printing.string_of_member fname ftype;
+        offset = foffset;
+        size = Static.sizeof ftype;
+        align = falign;
+        bits = None } :: members
+    (* Zero-width bitfields occupy no storage *)
+    | Static.BoxedBitfield { Static.bfwidth = 0 } -> members
+    | Static.BoxedBitfield { Static.bftype; bfoffset; bfbit; bfwidth; bfname } ->
+      { name = bfname;
+        decl = Type_printing.string_of_member ~width:bfwidth bfname bftype;
+        offset = bfoffset;
+        size = (bfbit + bfwidth + 7) / 8;
+        align = Structs_computed.member_alignment packing bftype;
+        bits = Some (bfbit, bfwidth) } :: members)
+    fields []
+
+(* The unused byte ranges between the members, and after the last member. *)
+let holes ~size members =
+  let hole_at pos offset holes =
+    if offset > pos then { hole_offset = pos; hole_size = offset - pos } :: holes
+    else holes in
+  let sorted = List.stable_sort (fun l r -> compare l.offset r.offset) members in
+  let pos, holes =
+    List.fold_left
+      (fun (pos, holes) m -> (max pos (m.offset + m.size), hole_at pos m.offset holes))
+      (0, []) sorted in
+  List.rev (hole_at pos size holes)
+
+let straddles ~cache_line ({ offset; size } : member) =
+  size > 0 && offset / cache_line <> (offset + size - 1) / cache_line
+
+(* A unit of reordering: a single member, or a run of adjacent bitfields,
+   whose relative positions must be preserved. *)
+type block = { names : string list; block_align : int; block_size : int }
+
+let blocks members =
+  let block_of (run : member list) =
+    let first = List.hd run and last = List.hd (List.rev run) in
+    let block_align = List.fold_left (fun a (m : member) -> max a m.align) 1 run in
+    let start = first.offset - first.offset mod block_align in
+    { names = List.map (fun m -> m.name) run; block_align;
+      block_size = last.offset + last.size - start } in
+  let rec loop run acc = function
+    | [] -> List.rev (if run = [] then acc else block_of (List.rev run) :: acc)
+    | ({ bits = Some _ } as m) :: ms -> loop (m :: run) acc ms
+    | m :: ms ->
+      let acc = if run = [] then acc else block_of (List.rev run) :: acc in
+      loop [] (block_of [m] :: acc) ms
+  in loop [] [] members
+
+let layout_size ~align blocks =
+  aligned_offset
+    (List.fold_left
+       (fun pos b -> aligned_offset pos b.block_align + b.block_size) 0 blocks)
+    align
+
+(* Placing the members in order of decreasing alignment, and then of
+   decreasing size, leaves no interior padding when every size is a multiple
+   of the corresponding alignment. *)
+let suggest ~size ~align members =
+  let blocks = blocks members in
+  let sorted = List.stable_sort
+      (fun l r -> compare (r.block_align, r.block_size) (l.block_align, l.block_size))
+      blocks in
+  let sorted_size = layout_size ~align sorted in
+  if sorted_size < size then List.concat (List.map (fun b -> b.names) sorted), sorted_size
+  else List.map (fun m -> m.name) members, size
+
+let analyse : type a s. ?cache_line:int -> (a, s) Static.structured Static.typ -> t =
+  fun ?(cache_line=64) ty ->
+    if cache_line <= 0 then invalid_arg "Ctypes.Layout.analyse";
+    let report kind tag packing fields =
+      let size = Static.sizeof ty and align = Static.alignment ty in
+      let members = members_of_fields packing fields in
+      let holes = holes ~size members in
+      let suggested_order, suggested_size = match kind with
+        | `Struct -> suggest ~size ~align members
+        | `Union -> List.map (fun m -> m.name) members, size in
+      { kind; tag; size; align; members; holes;
+        wasted = List.fold_left (fun w h -> w + h.hole_size) 0 holes;
+        cache_line;
+        straddling = List.filter (straddles ~cache_line) members;
+        suggested_order; suggested_size }
+    in
+    match ty with
+    | Static.Struct { Static.spec = Static.Incomplete _ } ->
+      raise Static.IncompleteType
+    | Static.Struct { Static.tag; packing; fields } ->
+      report `Struct tag packing fields
+    | Static.Union { Static.uspec = None } -> raise Static.IncompleteType
+    | Static.Union { Static.utag; upacking; ufields } ->
+      report `Union utag upacking ufields
+    | _ -> raise (Static.Unsupported "layout of non-structured type")
+
+let format fmt r =
+  let open Format in
+  let kind = match r.kind with `Struct -> "struct" | `Union -> "union" in
+  let format_member m =
+    fprintf fmt "@,  %-32s /* %4d %4d */" (m.decl ^ ";") m.offset m.size
+  and format_hole h =
+    fprintf fmt "@,  /* XXX %d byte%s hole */" h.hole_size
+      (if h.hole_size = 1 then "" else "s") in
+  let rec interleave members holes = match members, holes with
+    | [], hs -> List.iter format_hole hs
+    | m :: ms, h :: hs when h.hole_offset < m.offset ->
+      format_hole h; interleave members hs
+    | m :: ms, hs -> format_member m; interleave ms hs in
+  fprintf fmt "@[<v>%s %s {" kind r.tag;
+  interleave r.members r.holes;
+  fprintf fmt "@,}; /* size: %d, align: %d, members: %d */"
+    r.size r.align (List.length r.members);
+  fprintf fmt "@,/* wasted: %d byte%s */" r.wasted
+    (if r.wasted = 1 then "" else "s");
+  List.iter
+    (fun m -> fprintf fmt "@,/* %s straddles a %d-byte cache line boundary */"
+      m.name r.cache_line)
+    r.straddling;
+  if r.suggested_size < r.size then
+    fprintf fmt "@,/* suggested order (size: %d): %s */"
+      r.suggested_size (String.concat ", " r.suggested_order);
+  fprintf fmt "@]"
+
+let to_string r = Common.string_of format r
@@ -0,0 +1,39 @@
+(*
+ * Copyright (c) 2014 Jeremy Yallop.
+ *
+ * This file is distributed under the terms of the MIT License.
+ * See the file LICENSE for details.
+ *)
+
+(* Analysis of the layout of struct and union types. *)
+
+type member = {
+  name : string;
+  decl : string;
+  offset : int;
+  size : int;
+  align : int;
+  bits : (int * int) option;
+}
+
+type hole = { hole_offset : int; hole_size : int }
+
+type t = {
+  kind : [`Struct | `Union];
+  tag : string;
+  size : int;
+  align : int;
+  members : member list;
+  holes : hole list;
+  wasted : int;
+  cache_line : int;
+  straddling : member list;
+  suggested_order : string list;
+  suggested_size : int;
+}
+
+val analyse : ?cache_line:int -> (_, _) Static.structured Static.typ -> t
+
+val format : Format.formatter -> t -> unit
+
+val to_string : t -> string
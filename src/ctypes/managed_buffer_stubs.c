@@ -9,15 +9,36 @@
 #include <caml/memory.h>
 #include <caml/custom.h>
 #include <caml/fail.h>
+#include <caml/bigarray.h>
 
 #include <stdint.h>
+#include <stdlib.h>
 #include <string.h>
 
 #include "raw_pointer.h"
+#include "managed_buffer_stubs.h"
+
+/* The memory of a managed buffer is owned by the buffer until a bigarray
+   view shares it, at which point ownership passes to a reference-counted
+   bigarray proxy.  The data pointer comes first, so that the address of the
+   memory is also accessible as *(void **)Data_custom_val(v). */
+struct managed_buffer {
+  void *data;
+  struct caml_ba_proxy *proxy;
+  int finalised;
+};
+
+#define Managed_buffer_val(v) ((struct managed_buffer *)Data_custom_val(v))
 
 static void finalize_free(value v)
 {
-  free(*((void **)Data_custom_val(v)));
+  struct managed_buffer *b = Managed_buffer_val(v);
+  if (b->proxy == NULL)
+    free(b->data);
+  else if (--b->proxy->refcount == 0) {
+    free(b->proxy->data);
+    free(b->proxy);
+  }
 }
 
 static int compare_pointers(value l_, value r_)
@@ -44,12 +65,21 @@ static struct custom_operations managed_buffer_custom_ops = {
   custom_deserialize_default
 };
 
+static value alloc_managed_buffer(void *data)
+{
+  value block = caml_alloc_custom(&managed_buffer_custom_ops,
+                                  sizeof(struct managed_buffer), 0, 1);
+  struct managed_buffer *b = Managed_buffer_val(block);
+  b->data = data;
+  b->proxy = NULL;
+  b->finalised = 0;
+  return block;
+}
+
 /* copy_bytes : void * -> size_t -> managed_buffer */
 value ctypes_copy_bytes(void *src, size_t size)
 {
-  value block = caml_alloc_custom(&managed_buffer_custom_ops, sizeof(void*), 0, 1);
-  *(void **)Data_custom_val(block) = memcpy(caml_stat_alloc(size), src, size);
-  return block;
+  return alloc_managed_buffer(memcpy(caml_stat_alloc(size), src, size));
 }
 
 /* allocate : int -> managed_buffer */
@@ -57,12 +87,38 @@ value ctypes_allocate(value size_)
 {
   CAMLparam1(size_);
   int size = Int_val(size_);
-  CAMLlocal1(block);
-  block = caml_alloc_custom(&managed_buffer_custom_ops, sizeof(void*), 0, 1);
-  void *p = caml_stat_alloc(size);
-  void **d = (void **)Data_custom_val(block);
-  *d = p;
-  CAMLreturn(block);
+  CAMLreturn(alloc_managed_buffer(caml_stat_alloc(size)));
+}
+
+/* set_finalised : managed_buffer -> unit */
+value ctypes_set_finalised(value managed_buffer)
+{
+  Managed_buffer_val(managed_buffer)->finalised = 1;
+  return Val_unit;
+}
+
+struct caml_ba_proxy *ctypes_managed_buffer_proxy(value v)
+{
+  struct managed_buffer *b;
+  if (!Is_block(v) || Tag_val(v) != Custom_tag
+      || Custom_ops_val(v) != &managed_buffer_custom_ops)
+    return NULL;
+  b = Managed_buffer_val(v);
+  /* The finaliser of a buffer must not run while views of the buffer are
+     live, so views of such buffers keep the buffer itself alive. */
+  if (b->finalised)
+    return NULL;
+  if (b->proxy == NULL) {
+    struct caml_ba_proxy *proxy = malloc(sizeof *proxy);
+    if (proxy == NULL)
+      return NULL;
+    proxy->refcount = 1;
+    proxy->data = b->data;
+    proxy->size = 0;
+    b->proxy = proxy;
+  }
+  ++b->proxy->refcount;
+  return b->proxy;
 }
 
 /* block_address : managed_buffer -> immediate_pointer */
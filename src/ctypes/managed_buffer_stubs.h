@@ -9,6 +9,7 @@
 #define MANAGED_BUFFER_STUBS_H
 
 #include <caml/mlvalues.h>
+#include <caml/bigarray.h>
 
 /* copy_bytes : void * -> size_t -> managed_buffer */
 extern value ctypes_copy_bytes(void *, size_t);
@@ -19,4 +20,12 @@ extern value ctypes_allocate(value size);
 /* block_address : managed_buffer -> immediate_pointer */
 extern value ctypes_block_address(value managed_buffer);
 
+/* set_finalised : managed_buffer -> unit */
+extern value ctypes_set_finalised(value managed_buffer);
+
+/* Return a bigarray proxy that shares ownership of the memory of the managed
+   buffer [v], incrementing its reference count, or NULL if [v] is not a
+   managed buffer or its memory cannot be shared. */
+extern struct caml_ba_proxy *ctypes_managed_buffer_proxy(value v);
+
 #endif /* MANAGED_BUFFER_STUBS_H */
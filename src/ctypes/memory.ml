@@ -87,7 +87,7 @@ let rec (!@) : type a. a ptr -> a
       (* If it's a reference type then we take a reference *)
       | Union _ -> { structured = ptr }
       | Struct _ -> { structured = ptr }
-      | Array (elemtype, alength) ->
+      | Array (elemtype, alength, _) ->
         { astart = { ptr with reftype = elemtype }; alength }
       | Bigarray b -> Ctypes_bigarray.view b ?ref ~offset raw_ptr
       | Abstract _ -> { structured = ptr }
@@ -120,20 +120,27 @@ let from_voidp : type a. a typ -> unit ptr -> a ptr
 let to_voidp : type a. a ptr -> unit ptr
   = fun p -> { p with reftype = Void }
 
-let allocate_n : type a. ?finalise:(a ptr -> unit) -> a typ -> count:int -> a ptr
-  = fun ?finalise reftype ~count ->
+let allocate_bytes : type a. ?finalise:(a ptr -> unit) -> a typ -> int -> a ptr
+  = fun ?finalise reftype size ->
     let package p =
       { reftype; pbyte_offset = 0; raw_ptr = Stubs.block_address p;
         pmanaged = Some (Obj.repr p) } in
     let finalise = match finalise with
-      | Some f -> Gc.finalise (fun p -> f (package p))
+      | Some f -> fun p -> begin
+          Stubs.set_finalised p;
+          Gc.finalise (fun p -> f (package p)) p
+        end
       | None -> ignore
     in
-    let p = Stubs.allocate (count * sizeof reftype) in begin
+    let p = Stubs.allocate size in begin
       finalise p;
       package p
     end
 
+let allocate_n : type a. ?finalise:(a ptr -> unit) -> a typ -> count:int -> a ptr
+  = fun ?finalise reftype ~count ->
+    allocate_bytes ?finalise reftype (count * sizeof reftype)
+
 let allocate : type a. ?finalise:(a ptr -> unit) -> a typ -> a -> a ptr
   = fun ?finalise reftype v ->
     let p = allocate_n ?finalise ~count:1 reftype in begin
@@ -217,6 +224,47 @@ let (@.) { structured = p } f = p |-> f
 let setf s field v = (s @. field) <-@ v
 let getf s field = !@(s @. field)
 
+let rec read_bitfield : type a. a typ -> bit:int -> width:int ->
+  offset:int -> Raw.voidp -> a
+  = fun reftype ~bit ~width ~offset buf -> match reftype with
+    | Primitive p -> Stubs.read_bitfield p ~offset ~bit ~width buf
+    | View { read; ty } -> read (read_bitfield ty ~bit ~width ~offset buf)
+    | _ -> raise (Unsupported "bitfield of non-integer type")
+
+let rec write_bitfield : type a. a typ -> bit:int -> width:int ->
+  offset:int -> a -> Raw.voidp -> unit
+  = fun reftype ~bit ~width ~offset v buf -> match reftype with
+    | Primitive p -> Stubs.write_bitfield p ~offset ~bit ~width v buf
+    | View { write; ty } ->
+      write_bitfield ty ~bit ~width ~offset (write v) buf
+    | _ -> raise (Unsupported "bitfield of non-integer type")
+
+let getbf { structured = { raw_ptr; pbyte_offset } }
+    { bftype; bfoffset; bfbit; bfwidth } =
+  read_bitfield bftype ~bit:bfbit ~width:bfwidth
+    ~offset:(pbyte_offset + bfoffset) raw_ptr
+
+let setbf { structured = { raw_ptr; pbyte_offset } }
+    { bftype; bfoffset; bfbit; bfwidth } v =
+  write_bitfield bftype ~bit:bfbit ~width:bfwidth
+    ~offset:(pbyte_offset + bfoffset) v raw_ptr
+
+(* A struct with a flexible array member is allocated in a single block
+   that holds the struct and the trailing elements. *)
+let make_flexible ?finalise s { fxtype; fxoffset } ~count =
+  if count < 0 then invalid_arg "Ctypes.make_flexible";
+  let finalise = match finalise with
+    | Some f -> Some (fun structured -> f { structured })
+    | None -> None in
+  let size = max (sizeof s) (fxoffset + count * sizeof fxtype) in
+  { structured = allocate_bytes ?finalise s size }
+
+let getflex { structured = p } { fxtype; fxoffset } ~length =
+  if length < 0 then invalid_arg "Ctypes.getflex";
+  { astart = { p with reftype = fxtype;
+                      pbyte_offset = p.pbyte_offset + fxoffset };
+    alength = length }
+
 let addr { structured } = structured
 
 open Bigarray
@@ -292,6 +340,18 @@ let bigarray_elements : type a b c d f.
 let bigarray_of_ptr spec dims kind ptr =
   !@ (castp (bigarray spec dims kind) ptr)
 
+let genarray_of_ptr layout dims kind { raw_ptr; pbyte_offset; pmanaged } =
+  if Array.length dims > 16 || Array.fold_left (fun n d -> min n d) 0 dims < 0 then
+    invalid_arg "Ctypes.genarray_of_ptr";
+  Ctypes_bigarray.genarray_view layout dims kind ?ref:pmanaged raw_ptr
+    ~offset:pbyte_offset
+
+let genarray_start ba =
+  { reftype = Primitive (Ctypes_bigarray.prim_of_kind (Genarray.kind ba));
+    raw_ptr = Bigarray_stubs.address ba;
+    pmanaged = Some (Obj.repr ba);
+    pbyte_offset = 0 }
+
 let array_dims : type a b c d f.
    < element: a;
      ba_repr: f;
@@ -303,12 +363,12 @@ let array_dims : type a b c d f.
    | Array1 -> a.alength
    | Array2 ->
      begin match a.astart with 
-     | {reftype = Array (_, n)} -> (a.alength, n)
+     | {reftype = Array (_, n, _)} -> (a.alength, n)
      | _ -> raise (Unsupported "taking dimensions of non-array type")
     end
    | Array3 ->
      begin match a.astart with
-     | {reftype = Array (Array (_, m), n)} -> (a.alength, n, m)
+     | {reftype = Array (Array (_, m, _), n, _)} -> (a.alength, n, m)
      | _ -> raise (Unsupported "taking dimensions of non-array type")
      end
 
@@ -316,6 +376,106 @@ let bigarray_of_array spec kind a =
   let dims = array_dims spec a in
   !@ (castp (bigarray spec dims kind) (CArray.start a))
 
+let allocate_bigarray : type a b c d f.
+   < element: a;
+     ba_repr: f;
+     bigarray: b;
+     carray: c;
+     dims: d > bigarray_class -> d -> (a, f) kind -> b * c =
+  fun spec dims kind ->
+    let ba : b = match spec, dims with
+      | Genarray, ds -> Genarray.create kind c_layout ds
+      | Array1, d -> Array1.create kind c_layout d
+      | Array2, (d1, d2) -> Array2.create kind c_layout d1 d2
+      | Array3, (d1, d2, d3) -> Array3.create kind c_layout d1 d2 d3
+    in
+    (ba, array_of_bigarray spec ba)
+
+type 's column =
+  Column : ('a, 's) field * ('b, 'c, c_layout) Array1.t -> 's column
+
+let floating : type a. a Primitives.prim -> bool = fun p ->
+  match Primitives.ml_prim p with
+  | Primitives.ML_float | Primitives.ML_complex -> true
+  | _ -> false
+
+(* The address, field offset and element size of a column, checking that the
+   bigarray elements have the same representation as the field. *)
+let column_spec name length = function
+  | Column ({ ftype; foffset }, ba) ->
+    let elt = Ctypes_bigarray.prim_of_kind (Array1.kind ba) in
+    if Array1.dim ba <> length then invalid_arg name;
+    match ftype with
+    | Primitive p when Ctypes_primitives.sizeof p = Ctypes_primitives.sizeof elt
+                    && floating p = floating elt ->
+      (Bigarray_stubs.address ba, foffset, Ctypes_primitives.sizeof p)
+    | _ -> raise (Unsupported "column element type does not match field type")
+
+let gather { astart = { raw_ptr; pbyte_offset; reftype }; alength } columns =
+  let columns = List.map (column_spec "Ctypes.gather" alength) columns in
+  Stubs.gather ~src:raw_ptr ~src_offset:pbyte_offset ~stride:(sizeof reftype)
+    ~count:alength (Array.of_list columns)
+
+let scatter columns { astart = { raw_ptr; pbyte_offset; reftype }; alength } =
+  let columns = List.map (column_spec "Ctypes.scatter" alength) columns in
+  Stubs.scatter ~dst:raw_ptr ~dst_offset:pbyte_offset ~stride:(sizeof reftype)
+    ~count:alength (Array.of_list columns)
+
+(* The column and element size for a strided copy between the memory at
+   [p] and [ba]. *)
+let strided_spec name { reftype } ~stride ba =
+  let elt = Ctypes_bigarray.prim_of_kind (Array1.kind ba) in
+  if stride < 1 then invalid_arg name;
+  match reftype with
+  | Primitive p when Ctypes_primitives.sizeof p = Ctypes_primitives.sizeof elt
+                  && floating p = floating elt ->
+    let size = Ctypes_primitives.sizeof p in
+    [| (Bigarray_stubs.address ba, 0, size) |], stride * size
+  | _ -> raise (Unsupported "pointer type does not match bigarray kind")
+
+let gather_strided ({ raw_ptr; pbyte_offset } as p) ~stride ba =
+  let columns, stride = strided_spec "Ctypes.gather_strided" p ~stride ba in
+  Stubs.gather ~src:raw_ptr ~src_offset:pbyte_offset ~stride
+    ~count:(Array1.dim ba) columns
+
+let scatter_strided ba ({ raw_ptr; pbyte_offset } as p) ~stride =
+  let columns, stride = strided_spec "Ctypes.scatter_strided" p ~stride ba in
+  Stubs.scatter ~dst:raw_ptr ~dst_offset:pbyte_offset ~stride
+    ~count:(Array1.dim ba) columns
+
+module UInt64_array =
+struct
+  type t = Unsigned.uint64 carray
+
+  let of_bigarray (ba : (int64, int64_elt, c_layout) Array1.t) =
+    let { astart; alength } = array_of_bigarray Array1 ba in
+    { astart = castp uint64_t astart; alength }
+
+  let address { astart = { raw_ptr; pbyte_offset } } =
+    Raw.PtrType.(add raw_ptr (of_int pbyte_offset))
+
+  let binop name op ~dst a b =
+    if a.alength <> dst.alength || b.alength <> dst.alength then
+      invalid_arg name;
+    Stubs.uint64_binop op ~dst:(address dst) (address a) (address b)
+      ~count:dst.alength
+
+  let shift name op ~dst a n =
+    if a.alength <> dst.alength || n < 0 || n > 63 then invalid_arg name;
+    Stubs.uint64_shift op ~dst:(address dst) (address a) n ~count:dst.alength
+
+  let add = binop "Ctypes.UInt64_array.add" Stubs.Add
+  let sub = binop "Ctypes.UInt64_array.sub" Stubs.Sub
+  let mul = binop "Ctypes.UInt64_array.mul" Stubs.Mul
+  let logand = binop "Ctypes.UInt64_array.logand" Stubs.Logand
+  let logor = binop "Ctypes.UInt64_array.logor" Stubs.Logor
+  let logxor = binop "Ctypes.UInt64_array.logxor" Stubs.Logxor
+  let equal_mask = binop "Ctypes.UInt64_array.equal_mask" Stubs.Equal
+  let less_mask = binop "Ctypes.UInt64_array.less_mask" Stubs.Less
+  let shift_left = shift "Ctypes.UInt64_array.shift_left" Stubs.Shift_left
+  let shift_right = shift "Ctypes.UInt64_array.shift_right" Stubs.Shift_right
+end
+
 let genarray = Genarray
 let array1 = Array1
 let array2 = Array2
@@ -15,6 +15,11 @@ type managed_buffer
 external allocate : int -> managed_buffer
   = "ctypes_allocate"
 
+(* Record that the buffer has a finaliser, which must not run while any
+   bigarray view of the buffer is reachable. *)
+external set_finalised : managed_buffer -> unit
+  = "ctypes_set_finalised"
+
 (* Obtain the address of the managed block. *)
 external block_address : managed_buffer -> Ctypes_raw.voidp
   = "ctypes_block_address"
@@ -27,6 +32,16 @@ external read : 'a Primitives.prim -> offset:int -> Ctypes_raw.voidp -> 'a
 external write :  'a Primitives.prim -> offset:int -> 'a -> Ctypes_raw.voidp -> unit
   = "ctypes_write"
 
+(* Read a bitfield from a block of memory *)
+external read_bitfield : 'a Primitives.prim -> offset:int -> bit:int ->
+  width:int -> Ctypes_raw.voidp -> 'a
+  = "ctypes_read_bitfield"
+
+(* Write a bitfield to a block of memory *)
+external write_bitfield : 'a Primitives.prim -> offset:int -> bit:int ->
+  width:int -> 'a -> Ctypes_raw.voidp -> unit
+  = "ctypes_write_bitfield_byte6" "ctypes_write_bitfield"
+
 module Pointer =
 struct
   external read : offset:int -> Ctypes_raw.voidp -> Ctypes_raw.voidp
@@ -43,6 +58,36 @@ external memcpy :
     size:int -> unit
   = "ctypes_memcpy"
 
+(* Copy the fields of [count] records spaced [stride] bytes apart into
+   densely-packed columns, each described by an address, a field offset and
+   an element size. *)
+external gather : src:Ctypes_raw.voidp -> src_offset:int -> stride:int ->
+  count:int -> (Ctypes_raw.voidp * int * int) array -> unit
+  = "ctypes_gather"
+
+(* Copy densely-packed columns into the fields of [count] records spaced
+   [stride] bytes apart. *)
+external scatter : dst:Ctypes_raw.voidp -> dst_offset:int -> stride:int ->
+  count:int -> (Ctypes_raw.voidp * int * int) array -> unit
+  = "ctypes_scatter"
+
+(* Element-wise operations on arrays of uint64_t.  The order of the
+   constructors must correspond to the enumerations in uint64_array_stubs.c *)
+type uint64_binop = Add | Sub | Mul | Logand | Logor | Logxor | Equal | Less
+type uint64_shift = Shift_left | Shift_right
+
+(* Combine the [count] elements at two addresses, storing the results at
+   [dst]. *)
+external uint64_binop : uint64_binop -> dst:Ctypes_raw.voidp ->
+  Ctypes_raw.voidp -> Ctypes_raw.voidp -> count:int -> unit
+  = "ctypes_uint64_binop"
+
+(* Shift the [count] elements at an address, storing the results at
+   [dst]. *)
+external uint64_shift : uint64_shift -> dst:Ctypes_raw.voidp ->
+  Ctypes_raw.voidp -> int -> count:int -> unit
+  = "ctypes_uint64_shift"
+
 (* Read a fixed length OCaml string from memory *)
 external string_of_array : Ctypes_raw.voidp -> offset:int -> len:int -> string
   = "ctypes_string_of_array"
@@ -9,6 +9,7 @@
 #define CTYPES_PRIMITIVES_H
 
 #include <limits.h>
+#include <stddef.h>
 #include <stdint.h>
 
 #include "unsigned_stubs.h"
@@ -41,6 +42,9 @@ enum ctypes_primitive {
   Double,
   Complex32,
   Complex64,
+  Long_as_int,
+  Llong_as_int,
+  Size_t_as_int,
 };
 
 /* short is at least 16 bits. */
@@ -109,4 +113,14 @@ enum ctypes_primitive {
 # error "No suitable OCaml type available for representing size_t values"
 #endif
 
+/* Conversions between long, long long and size_t and OCaml's int.  The
+   conversions to int raise Failure and the conversions from int raise
+   Invalid_argument if the value is not representable. */
+extern value ctypes_copy_long_as_int(long l);
+extern value ctypes_copy_llong_as_int(long long l);
+extern value ctypes_copy_size_t_as_int(size_t s);
+extern long ctypes_long_as_int_val(value v);
+extern long long ctypes_llong_as_int_val(value v);
+extern size_t ctypes_size_t_as_int_val(value v);
+
 #endif /* CTYPES_PRIMITIVES_H */
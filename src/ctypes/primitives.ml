@@ -35,6 +35,9 @@ type _ prim =
  | Double : float prim
  | Complex32 : Complex.t prim
  | Complex64 : Complex.t prim
+ | Long_as_int : int prim
+ | Llong_as_int : int prim
+ | Size_t_as_int : int prim
 
 type _ ml_prim = 
   | ML_char :  char ml_prim
@@ -84,3 +87,6 @@ let ml_prim : type a. a prim -> a ml_prim = function
   | Double -> ML_float
   | Complex32 -> ML_complex
   | Complex64 -> ML_complex
+  | Long_as_int -> ML_int
+  | Llong_as_int -> ML_int
+  | Size_t_as_int -> ML_int
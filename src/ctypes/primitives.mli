@@ -39,6 +39,9 @@ type _ prim =
  | Double : float prim
  | Complex32 : Complex.t prim
  | Complex64 : Complex.t prim
+ | Long_as_int : int prim
+ | Llong_as_int : int prim
+ | Size_t_as_int : int prim
 
 type _ ml_prim = 
   | ML_char :  char ml_prim
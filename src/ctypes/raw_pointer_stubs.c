@@ -28,6 +28,77 @@ value ctypes_memcpy(value dst, value dst_offset,
 }
 
 
+/* A destination or source column for [gather] and [scatter]: a densely
+   packed array of [size]-byte elements, each corresponding to the field at
+   [offset] in a record. */
+struct column { char *data; size_t offset; size_t size; };
+
+static struct column *read_columns(value columns_, size_t *ncols)
+{
+  size_t i, n = Wosize_val(columns_);
+  struct column *cols = caml_stat_alloc((n ? n : 1) * sizeof *cols);
+  for (i = 0; i < n; i++) {
+    value c = Field(columns_, i);
+    cols[i].data = CTYPES_TO_PTR(Field(c, 0));
+    cols[i].offset = Long_val(Field(c, 1));
+    cols[i].size = Long_val(Field(c, 2));
+  }
+  *ncols = n;
+  return cols;
+}
+
+/* Copy with a constant size in the common cases, so that each copy becomes a
+   single load and store. */
+static void copy_element(char *dst, const char *src, size_t size)
+{
+  switch (size)
+  {
+  case 1: memcpy(dst, src, 1); break;
+  case 2: memcpy(dst, src, 2); break;
+  case 4: memcpy(dst, src, 4); break;
+  case 8: memcpy(dst, src, 8); break;
+  case 16: memcpy(dst, src, 16); break;
+  default: memcpy(dst, src, size); break;
+  }
+}
+
+/* gather : src:raw_pointer -> src_offset:int -> stride:int -> count:int ->
+            (raw_pointer * int * int) array -> unit */
+value ctypes_gather(value src_, value src_offset_, value stride_,
+                    value count_, value columns_)
+{
+  CAMLparam5(src_, src_offset_, stride_, count_, columns_);
+  const char *src = (char *)CTYPES_TO_PTR(src_) + Long_val(src_offset_);
+  size_t stride = Long_val(stride_), count = Long_val(count_);
+  size_t i, c, ncols;
+  struct column *cols = read_columns(columns_, &ncols);
+  for (i = 0; i < count; i++, src += stride)
+    for (c = 0; c < ncols; c++)
+      copy_element(cols[c].data + i * cols[c].size,
+                   src + cols[c].offset, cols[c].size);
+  caml_stat_free(cols);
+  CAMLreturn(Val_unit);
+}
+
+/* scatter : dst:raw_pointer -> dst_offset:int -> stride:int -> count:int ->
+             (raw_pointer * int * int) array -> unit */
+value ctypes_scatter(value dst_, value dst_offset_, value stride_,
+                     value count_, value columns_)
+{
+  CAMLparam5(dst_, dst_offset_, stride_, count_, columns_);
+  char *dst = (char *)CTYPES_TO_PTR(dst_) + Long_val(dst_offset_);
+  size_t stride = Long_val(stride_), count = Long_val(count_);
+  size_t i, c, ncols;
+  struct column *cols = read_columns(columns_, &ncols);
+  for (i = 0; i < count; i++, dst += stride)
+    for (c = 0; c < ncols; c++)
+      copy_element(dst + cols[c].offset,
+                   cols[c].data + i * cols[c].size, cols[c].size);
+  caml_stat_free(cols);
+  CAMLreturn(Val_unit);
+}
+
+
 /* string_of_cstring : raw_ptr -> int -> string */
 value ctypes_string_of_cstring(value p, value offset)
 {
@@ -10,8 +10,19 @@
 exception IncompleteType
 exception ModifyingSealedType of string
 exception Unsupported of string
+(* A function passed to C was collected before it was called. *)
+exception CallToExpiredClosure
 
-type incomplete_size = { mutable isize: int }
+(* The packing of a struct or union type: [packed] corresponds to
+   __attribute__((packed)) and [pack] to #pragma pack(n). *)
+type packing = { packed: bool; pack: int option }
+
+type incomplete_size = {
+  mutable isize: int;
+  mutable ibits: int;
+  (* whether the last member added is a flexible array member *)
+  mutable iflexible: bool;
+}
 
 type structured_spec = { size: int; align: int; }
 
@@ -19,6 +30,19 @@ type 'a structspec =
     Incomplete of incomplete_size
   | Complete of structured_spec
 
+(* The size, alignment, passability and interned descriptor (see Type_id)
+   of array and view types, computed on first use and then reused.  They
+   cannot be computed when the type is built, since the element type may be
+   a struct or union that is not yet sealed; once computed they never
+   change. *)
+type layout_cache = {
+  mutable csize: int;             (* negative until computed *)
+  mutable calign: int;            (* negative until computed *)
+  mutable cpassable: bool option;
+  mutable cid: int;               (* negative until interned *)
+  mutable cserial: int;           (* views only: negative until assigned *)
+}
+
 type abstract_type = {
   aname : string;
   asize : int;
@@ -33,7 +57,8 @@ type _ typ =
   | Union           : 'a union_type      -> 'a union typ
   | Abstract        : abstract_type      -> 'a abstract typ
   | View            : ('a, 'b) view      -> 'a typ
-  | Array           : 'a typ * int       -> 'a carray typ
+  | Array           : 'a typ * int * layout_cache
+                                         -> 'a carray typ
   | Bigarray        : (_, 'a) Ctypes_bigarray.t
                                          -> 'a typ
 and 'a ptr = { reftype      : 'a typ;
@@ -50,25 +75,46 @@ and ('a, 'b) view = {
   write : 'a -> 'b;
   format_typ: ((Format.formatter -> unit) -> Format.formatter -> unit) option;
   ty: 'b typ;
+  vcache: layout_cache;
 }
 and ('a, 's) field = {
   ftype: 'a typ;
   foffset: int;
   fname: string;
+  falign: int;
+}
+and ('a, 's) bitfield = {
+  bftype: 'a typ;
+  (* the offset in bytes of the first byte that holds the bitfield *)
+  bfoffset: int;
+  (* the position of the first bit within the byte at bfoffset, counting in
+     the order in which bits are allocated *)
+  bfbit: int;
+  bfwidth: int;
+  bfname: string;
+}
+and ('a, 's) flexible = {
+  fxtype: 'a typ;
+  fxoffset: int;
+  fxname: string;
 }
 and 'a structure_type = {
   tag: string;
+  packing: packing;
   mutable spec: 'a structspec;
   (* fields are in reverse order iff the struct type is incomplete *)
   mutable fields : 'a structure boxed_field list;
 }
 and 'a union_type = {
   utag: string;
+  upacking: packing;
   mutable uspec: structured_spec option;
   (* fields are in reverse order iff the union type is incomplete *)
   mutable ufields : 'a union boxed_field list;
 }
-and 's boxed_field = BoxedField : ('a, 's) field -> 's boxed_field
+and 's boxed_field =
+    BoxedField : ('a, 's) field -> 's boxed_field
+  | BoxedBitfield : ('a, 's) bitfield -> 's boxed_field
 
 type _ bigarray_class =
   Genarray :
@@ -111,11 +157,17 @@ let rec sizeof : type a. a typ -> int = function
   | Union { uspec = None }         -> raise IncompleteType
   | Union { uspec = Some { size } }
                                    -> size
-  | Array (t, i)                   -> i * sizeof t
+  | Array (_, _, { csize })
+      when csize >= 0              -> csize
+  | Array (t, i, cache)            -> let size = i * sizeof t in
+                                      cache.csize <- size; size
   | Bigarray ba                    -> Ctypes_bigarray.sizeof ba
   | Abstract { asize }             -> asize
   | Pointer _                      -> Ctypes_primitives.pointer_size
-  | View { ty }                    -> sizeof ty
+  | View { vcache = { csize } }
+      when csize >= 0              -> csize
+  | View { ty; vcache }            -> let size = sizeof ty in
+                                      vcache.csize <- size; size
 
 let rec alignment : type a. a typ -> int = function
     Void                             -> raise IncompleteType
@@ -125,11 +177,17 @@ let rec alignment : type a. a typ -> int = function
       { align } }                    -> align
   | Union { uspec = None }           -> raise IncompleteType
   | Union { uspec = Some { align } } -> align
-  | Array (t, _)                     -> alignment t
+  | Array (_, _, { calign })
+      when calign >= 0               -> calign
+  | Array (t, _, cache)              -> let align = alignment t in
+                                        cache.calign <- align; align
   | Bigarray ba                      -> Ctypes_bigarray.alignment ba
   | Abstract { aalignment }          -> aalignment
   | Pointer _                        -> Ctypes_primitives.pointer_alignment 
-  | View { ty }                      -> alignment ty
+  | View { vcache = { calign } }
+      when calign >= 0               -> calign
+  | View { ty; vcache }              -> let align = alignment ty in
+                                        vcache.calign <- align; align
 
 let rec passable : type a. a typ -> bool = function
     Void                           -> true
@@ -142,7 +200,10 @@ let rec passable : type a. a typ -> bool = function
   | Bigarray _                     -> false
   | Pointer _                      -> true
   | Abstract _                     -> false
-  | View { ty }                    -> passable ty
+  | View { vcache = { cpassable = Some p } }
+                                   -> p
+  | View { ty; vcache }            -> let p = passable ty in
+                                      vcache.cpassable <- Some p; p
 
 let void = Void
 let char = Primitive Primitives.Char
@@ -167,20 +228,33 @@ let uint16_t = Primitive Primitives.Uint16_t
 let uint32_t = Primitive Primitives.Uint32_t
 let uint64_t = Primitive Primitives.Uint64_t
 let size_t = Primitive Primitives.Size_t
+let long_as_int = Primitive Primitives.Long_as_int
+let llong_as_int = Primitive Primitives.Llong_as_int
+let size_t_as_int = Primitive Primitives.Size_t_as_int
 let ushort = Primitive Primitives.Ushort
 let uint = Primitive Primitives.Uint
 let ulong = Primitive Primitives.Ulong
 let ullong = Primitive Primitives.Ullong
-let array i t = Array (t, i)
+let layout_cache () =
+  { csize = -1; calign = -1; cpassable = None; cid = -1; cserial = -1 }
+let array i t = Array (t, i, layout_cache ())
 let ptr t = Pointer t
+(* Arrays and bigarrays are passed by address, as C passes arrays. *)
+let rec passable_argument : type a. a typ -> bool = function
+  | Array _ -> true
+  | Bigarray _ -> true
+  | View { ty } -> passable_argument ty
+  | ty -> passable ty
+
 let ( @->) f t =
-  if not (passable f) then
+  if not (passable_argument f) then
     raise (Unsupported "Unsupported argument type")
   else
     Function (f, t)
 let abstract ~name ~size ~alignment =
   Abstract { aname = name; asize = size; aalignment = alignment }
-let view ?format_typ ~read ~write ty = View { read; write; format_typ; ty }
+let view ?format_typ ~read ~write ty =
+  View { read; write; format_typ; ty; vcache = layout_cache () }
 let bigarray : type a b c d e.
   < element: a;
     dims: b;
@@ -201,10 +275,20 @@ let returning v =
   else
     Returns v
 
-let structure tag =
-  Struct { spec = Incomplete { isize = 0 }; tag; fields = [] }
+let make_packing name ?(packed=false) ?pack () =
+  match pack with
+  | Some n when n <= 0 || n land (n - 1) <> 0 -> invalid_arg name
+  | _ -> { packed; pack }
+
+let structure ?packed ?pack tag =
+  let packing = make_packing "Ctypes.structure" ?packed ?pack () in
+  Struct { spec = Incomplete { isize = 0; ibits = 0; iflexible = false };
+           tag; packing;
+           fields = [] }
 
-let union utag = Union { utag; uspec = None; ufields = [] }
+let union ?packed ?pack utag =
+  let upacking = make_packing "Ctypes.union" ?packed ?pack () in
+  Union { utag; upacking; uspec = None; ufields = [] }
 
 let offsetof { foffset } = foffset
 let field_type { ftype } = ftype
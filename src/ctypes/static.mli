@@ -7,13 +7,33 @@
 
 (* C type construction.  Internal representation, not for public use. *)
 
+(* The size, alignment, passability and interned descriptor (see Type_id)
+   of array and view types, computed on first use and then reused.  They
+   cannot be computed when the type is built, since the element type may be
+   a struct or union that is not yet sealed; once computed they never
+   change. *)
+type layout_cache = {
+  mutable csize: int;             (* negative until computed *)
+  mutable calign: int;            (* negative until computed *)
+  mutable cpassable: bool option;
+  mutable cid: int;               (* negative until interned *)
+  mutable cserial: int;           (* views only: negative until assigned *)
+}
+
 type abstract_type = {
   aname : string;
   asize : int;
   aalignment : int;
 }
 
-type incomplete_size = { mutable isize: int }
+type packing = { packed: bool; pack: int option }
+
+type incomplete_size = {
+  mutable isize: int;
+  mutable ibits: int;
+  (* whether the last member added is a flexible array member *)
+  mutable iflexible: bool;
+}
 
 type structured_spec = { size: int; align: int; }
 
@@ -29,7 +49,8 @@ type _ typ =
   | Union           : 'a union_type      -> 'a union typ
   | Abstract        : abstract_type      -> 'a abstract typ
   | View            : ('a, 'b) view      -> 'a typ
-  | Array           : 'a typ * int       -> 'a carray typ
+  | Array           : 'a typ * int * layout_cache
+                                         -> 'a carray typ
   | Bigarray        : (_, 'a) Ctypes_bigarray.t
                                          -> 'a typ
 and 'a ptr = { reftype      : 'a typ;
@@ -46,23 +67,41 @@ and ('a, 'b) view = {
   write : 'a -> 'b;
   format_typ: ((Format.formatter -> unit) -> Format.formatter -> unit) option;
   ty: 'b typ;
+  vcache: layout_cache;
 }
 and ('a, 's) field = {
   ftype: 'a typ;
   foffset: int;
   fname: string;
+  falign: int;
+}
+and ('a, 's) bitfield = {
+  bftype: 'a typ;
+  bfoffset: int;
+  bfbit: int;
+  bfwidth: int;
+  bfname: string;
+}
+and ('a, 's) flexible = {
+  fxtype: 'a typ;
+  fxoffset: int;
+  fxname: string;
 }
 and 'a structure_type = {
   tag: string;
+  packing: packing;
   mutable spec: 'a structspec;
   mutable fields : 'a structure boxed_field list;
 }
 and 'a union_type = {
   utag: string;
+  upacking: packing;
   mutable uspec: structured_spec option;
   mutable ufields : 'a union boxed_field list;
 }
-and 's boxed_field = BoxedField : ('a, 's) field -> 's boxed_field
+and 's boxed_field =
+    BoxedField : ('a, 's) field -> 's boxed_field
+  | BoxedBitfield : ('a, 's) bitfield -> 's boxed_field
 
 type _ bigarray_class =
   Genarray :
@@ -123,6 +162,9 @@ val uint16_t : Unsigned.UInt16.t typ
 val uint32_t : Unsigned.UInt32.t typ
 val uint64_t : Unsigned.UInt64.t typ
 val size_t : Unsigned.size_t typ
+val long_as_int : int typ
+val llong_as_int : int typ
+val size_t_as_int : int typ
 val ushort : Unsigned.ushort typ
 val uint : Unsigned.uint typ
 val ulong : Unsigned.ulong typ
@@ -141,11 +183,12 @@ val bigarray : < ba_repr : 'c;
                  element : 'a > bigarray_class ->
                'b -> ('a, 'c) Bigarray.kind -> 'd typ
 val returning : 'a typ -> 'a fn
-val structure : string -> 'a structure typ
-val union : string -> 'a union typ
+val structure : ?packed:bool -> ?pack:int -> string -> 'a structure typ
+val union : ?packed:bool -> ?pack:int -> string -> 'a union typ
 val offsetof : ('a, 'b) field -> int
 val field_type : ('a, 'b) field -> 'a typ
 
 exception IncompleteType
 exception ModifyingSealedType of string
 exception Unsupported of string
+exception CallToExpiredClosure
@@ -10,7 +10,13 @@ open Static
 module type S =
 sig
   type (_, _) field
-  val field : 't typ -> string -> 'a typ ->
+  type (_, _) bitfield
+  type (_, _) flexible
+  val field : ?align:int -> 't typ -> string -> 'a typ ->
     ('a, (('s, [<`Struct | `Union]) structured as 't)) field
+  val bitfield : 't typ -> string -> width:int -> 'a typ ->
+    ('a, (('s, [<`Struct | `Union]) structured as 't)) bitfield
+  val flexible_array : 't typ -> string -> 'a typ ->
+    ('a, (('s, [`Struct]) structured as 't)) flexible
   val seal : (_, [< `Struct | `Union]) Static.structured Static.typ -> unit
 end
@@ -7,15 +7,31 @@
 
 open Static
 
-let max_field_alignment fields =
+(* The alignment of a member of a struct or union with the given packing.
+   As with __attribute__((packed)), a packed member loses its natural
+   alignment but keeps any explicitly requested alignment; as with #pragma
+   pack(n), [pack] caps every alignment, including explicit requests. *)
+let member_alignment { packed; pack } ?align ty =
+  let natural = if packed then 1 else alignment ty in
+  let align = match align with None -> natural | Some a -> max natural a in
+  match pack with None -> align | Some n -> min n align
+
+let max_field_alignment packing fields =
   List.fold_left
-    (fun align (BoxedField {ftype}) -> max align (alignment ftype))
-    0
+    (fun align -> function
+      | BoxedField {falign} -> max align falign
+      (* Zero-width bitfields pad, but do not affect the alignment. *)
+      | BoxedBitfield {bfwidth = 0} -> align
+      | BoxedBitfield {bftype} -> max align (member_alignment packing bftype))
+    1
     fields
 
 let max_field_size fields =
   List.fold_left
-    (fun size (BoxedField {ftype}) -> max size (sizeof ftype))
+    (fun size -> function
+      | BoxedField {ftype} -> max size (sizeof ftype)
+      | BoxedBitfield {bfwidth = 0} -> size
+      | BoxedBitfield {bftype} -> max size (sizeof bftype))
     0
     fields
 
@@ -24,30 +40,115 @@ let aligned_offset offset alignment =
     0 -> offset
   | overhang -> offset - overhang + alignment
 
-let field (type k) (structured : (_, k) structured typ) label ftype =
+let field ?align (type k) (structured : (_, k) structured typ) label ftype =
+  begin match align with
+  | Some a when a <= 0 || a land (a - 1) <> 0 -> invalid_arg "Ctypes.field"
+  | _ -> ()
+  end;
   match structured with
-  | Struct ({ spec = Incomplete spec } as s) ->
-    let foffset = aligned_offset spec.isize (alignment ftype) in
-    let field = { ftype; foffset; fname = label } in
+  | Struct { spec = Incomplete { iflexible = true } } ->
+    raise (Unsupported "field after a flexible array member")
+  | Struct ({ spec = Incomplete spec; packing } as s) ->
+    let falign = member_alignment packing ?align ftype in
+    let foffset = aligned_offset spec.isize falign in
+    let field = { ftype; foffset; fname = label; falign } in
     begin
       spec.isize <- foffset + sizeof ftype;
+      spec.ibits <- 8 * spec.isize;
       s.fields <- BoxedField field :: s.fields;
       field
     end
-  | Union ({ uspec = None } as u) ->
-    let field = { ftype; foffset = 0; fname = label } in
+  | Union ({ uspec = None; upacking } as u) ->
+    let falign = member_alignment upacking ?align ftype in
+    let field = { ftype; foffset = 0; fname = label; falign } in
     u.ufields <- BoxedField field :: u.ufields;
     field
   | Struct { tag; spec = Complete _ } -> raise (ModifyingSealedType tag)
   | Union { utag } -> raise (ModifyingSealedType utag)
   | _ -> raise (Unsupported "Adding a field to non-structured type")
 
+let rec bitfield_storage : type a. a typ -> unit =
+  let open Primitives in function
+  | Primitive (Char | Schar | Uchar | Short | Int | Long | Llong
+              | Ushort | Uint | Ulong | Ullong | Size_t
+              | Int8_t | Int16_t | Int32_t | Int64_t
+              | Uint8_t | Uint16_t | Uint32_t | Uint64_t
+              | Long_as_int | Llong_as_int | Size_t_as_int) -> ()
+  | View { ty } -> bitfield_storage ty
+  | _ -> raise (Unsupported "bitfield of non-integer type")
+
+(* Bitfields are allocated in the order of declaration within storage units
+   of the declared type, following the System V ABI: a bitfield never
+   straddles a storage unit boundary and a zero-width bitfield pads to the
+   next unit.  In packed structs bitfields are allocated contiguously, but a
+   zero-width bitfield still pads to the natural alignment of its type, as
+   with GCC and Clang. *)
+let bitfield (type k) (structured : (_, k) structured typ) label ~width bftype =
+  let () = bitfield_storage bftype in
+  let unit_bits = 8 * sizeof bftype in
+  if width < 0 || width > unit_bits then invalid_arg "Ctypes.bitfield";
+  match structured with
+  | Struct { spec = Incomplete { iflexible = true } } ->
+    raise (Unsupported "field after a flexible array member")
+  | Struct ({ spec = Incomplete spec; packing } as s) ->
+    let start =
+      if width = 0 then
+        aligned_offset spec.ibits (8 * alignment bftype)
+      else if packing.packed || packing.pack <> None then spec.ibits
+      else if spec.ibits mod unit_bits + width > unit_bits
+      then aligned_offset spec.ibits unit_bits
+      else spec.ibits in
+    let bfoffset = start / 8 and bfbit = start mod 8 in
+    if bfbit + width > 64 then
+      raise (Unsupported "bitfield spanning more than 64 bits");
+    let bitfield = { bftype; bfoffset; bfbit; bfwidth = width;
+                     bfname = label } in
+    begin
+      spec.ibits <- start + width;
+      spec.isize <- (spec.ibits + 7) / 8;
+      s.fields <- BoxedBitfield bitfield :: s.fields;
+      bitfield
+    end
+  | Union ({ uspec = None } as u) ->
+    let bitfield = { bftype; bfoffset = 0; bfbit = 0; bfwidth = width;
+                     bfname = label } in
+    u.ufields <- BoxedBitfield bitfield :: u.ufields;
+    bitfield
+  | Struct { tag; spec = Complete _ } -> raise (ModifyingSealedType tag)
+  | Union { utag } -> raise (ModifyingSealedType utag)
+  | _ -> raise (Unsupported "Adding a field to non-structured type")
+
+(* A flexible array member is added as a zero-length array, as with the GNU
+   extension, which gives the member the offset and alignment that C
+   requires and leaves the size of the struct unchanged. *)
+let flexible_array (type k) (structured : (_, k) structured typ) label fxtype =
+  match structured with
+  | Struct { spec = Incomplete _; fields = [] } ->
+    raise (Unsupported "flexible array member in a struct with no other fields")
+  | Struct { spec = Incomplete { iflexible = true } } ->
+    raise (Unsupported "field after a flexible array member")
+  | Struct ({ spec = Incomplete spec; packing } as s) ->
+    let ftype = array 0 fxtype in
+    let falign = member_alignment packing ftype in
+    let foffset = aligned_offset spec.isize falign in
+    let field = { ftype; foffset; fname = label; falign } in
+    begin
+      spec.isize <- foffset + sizeof ftype;
+      spec.ibits <- 8 * spec.isize;
+      spec.iflexible <- true;
+      s.fields <- BoxedField field :: s.fields;
+      { fxtype; fxoffset = foffset; fxname = label }
+    end
+  | Struct { tag; spec = Complete _ } -> raise (ModifyingSealedType tag)
+  | Union _ -> raise (Unsupported "flexible array member in a union")
+  | _ -> raise (Unsupported "Adding a field to non-structured type")
+
 let seal (type a) (type s) : (a, s) structured typ -> unit = function
   | Struct { fields = [] } -> raise (Unsupported "struct with no fields")
   | Struct { spec = Complete _; tag } -> raise (ModifyingSealedType tag)
-  | Struct ({ spec = Incomplete { isize } } as s) ->
+  | Struct ({ spec = Incomplete { isize }; packing } as s) ->
     s.fields <- List.rev s.fields;
-    let align = max_field_alignment s.fields in
+    let align = max_field_alignment packing s.fields in
     let size = aligned_offset isize align in
     s.spec <- Complete { (* sraw_io;  *)size; align }
   | Union { utag; uspec = Some _ } ->
@@ -57,7 +158,7 @@ let seal (type a) (type s) : (a, s) structured typ -> unit = function
   | Union u -> begin
     u.ufields <- List.rev u.ufields;
     let size = max_field_size u.ufields
-    and align = max_field_alignment u.ufields in
+    and align = max_field_alignment u.upacking u.ufields in
     u.uspec <- Some { align; size = aligned_offset size align }
   end
   | _ -> raise (Unsupported "Sealing a non-structured type")
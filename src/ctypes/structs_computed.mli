@@ -10,3 +10,9 @@
 
 include Structs.S
   with type ('a, 's) field := ('a, 's) Static.field
+   and type ('a, 's) bitfield := ('a, 's) Static.bitfield
+   and type ('a, 's) flexible := ('a, 's) Static.flexible
+
+val member_alignment : Static.packing -> ?align:int -> 'a Static.typ -> int
+(* The alignment of a member of a struct or union with the given packing,
+   with an optional explicitly requested alignment. *)
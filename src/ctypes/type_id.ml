@@ -0,0 +1,249 @@
+(*
+ * Copyright (c) 2014 Jeremy Yallop.
+ *
+ * This file is distributed under the terms of the MIT License.
+ * See the file LICENSE for details.
+ *)
+
+(* Hash-consed descriptors for types and function signatures. *)
+
+open Static
+
+type t = { id : int; fingerprint : int64; descr : descr }
+
+and member =
+    Field of string * int * t
+  | Bits of string * int * int * int * t
+
+(* The children of a descriptor are themselves interned, so comparing and
+   hashing a descriptor touches only a single level of the type. *)
+and descr =
+    DVoid
+  | DPrimitive of string
+  (* An integer type read and written as an OCaml int. *)
+  | DPrimitive_as_int of string
+  | DPointer of t
+  | DStruct of string * int * int * member list
+  | DUnion of string * int * int * member list
+  (* A struct or union reached through a pointer, identified by its tag as
+     in C.  This also breaks the cycles in recursive types. *)
+  | DStructRef of string
+  | DUnionRef of string
+  | DAbstract of string * int * int
+  (* Views are distinguished by identity: each has its own serial number. *)
+  | DView of int * t
+  | DArray of t * int
+  | DBigarray of string
+  | DReturns of t
+  | DFunction of t * t
+
+(* 64-bit FNV-1a, which gives the same fingerprint in every run. *)
+let fnv_offset_basis = 0xcbf29ce484222325L
+let fnv_prime = 0x100000001b3L
+
+let mix_byte h b = Int64.mul (Int64.logxor h (Int64.of_int (b land 0xff))) fnv_prime
+
+let mix_int64 h n =
+  let h = ref h in
+  for i = 0 to 7 do
+    h := mix_byte !h (Int64.to_int (Int64.shift_right_logical n (8 * i)))
+  done;
+  !h
+
+let mix_int h n = mix_int64 h (Int64.of_int n)
+
+let mix_string h s =
+  let h = ref (mix_int h (String.length s)) in
+  String.iter (fun c -> h := mix_byte !h (Char.code c)) s;
+  !h
+
+let mix_member h = function
+  | Field (name, offset, t) ->
+    mix_int64 (mix_int (mix_string (mix_int h 0) name) offset) t.fingerprint
+  | Bits (name, offset, bit, width, t) ->
+    mix_int64 (mix_int (mix_int (mix_int (mix_string (mix_int h 1) name)
+                                    offset) bit) width) t.fingerprint
+
+let mix_aggregate h tag size align members =
+  List.fold_left mix_member
+    (mix_int (mix_int (mix_int (mix_string h tag) size) align)
+       (List.length members))
+    members
+
+(* The fingerprint depends only on the C type: views have the fingerprint of
+   the underlying type. *)
+let fingerprint_of_descr = function
+  | DVoid -> mix_string fnv_offset_basis "void"
+  | DPrimitive name
+  | DPrimitive_as_int name -> mix_string (mix_string fnv_offset_basis "prim") name
+  | DPointer t -> mix_int64 (mix_string fnv_offset_basis "ptr") t.fingerprint
+  | DStruct (tag, size, align, members) ->
+    mix_aggregate (mix_string fnv_offset_basis "struct") tag size align members
+  | DUnion (tag, size, align, members) ->
+    mix_aggregate (mix_string fnv_offset_basis "union") tag size align members
+  | DStructRef tag -> mix_string (mix_string fnv_offset_basis "struct*") tag
+  | DUnionRef tag -> mix_string (mix_string fnv_offset_basis "union*") tag
+  | DAbstract (name, size, align) ->
+    mix_int (mix_int (mix_string (mix_string fnv_offset_basis "abstract")
+                        name) size) align
+  | DView (_, t) -> t.fingerprint
+  | DArray (t, n) ->
+    mix_int (mix_int64 (mix_string fnv_offset_basis "array") t.fingerprint) n
+  | DBigarray d -> mix_string (mix_string fnv_offset_basis "bigarray") d
+  | DReturns t ->
+    mix_int64 (mix_string fnv_offset_basis "returns") t.fingerprint
+  | DFunction (arg, rest) ->
+    mix_int64 (mix_int64 (mix_string fnv_offset_basis "fn") arg.fingerprint)
+      rest.fingerprint
+
+(* Children are compared physically: while a descriptor is reachable it is
+   the only descriptor for its type. *)
+let same_member l r = match l, r with
+  | Field (n, o, t), Field (n', o', t') -> n = n' && o = o' && t == t'
+  | Bits (n, o, b, w, t), Bits (n', o', b', w', t') ->
+    n = n' && o = o' && b = b' && w = w' && t == t'
+  | _ -> false
+
+let rec same_members l r = match l, r with
+  | [], [] -> true
+  | m :: ms, m' :: ms' -> same_member m m' && same_members ms ms'
+  | _ -> false
+
+let same_descr l r = match l, r with
+  | DVoid, DVoid -> true
+  | DPrimitive n, DPrimitive n'
+  | DPrimitive_as_int n, DPrimitive_as_int n'
+  | DStructRef n, DStructRef n'
+  | DUnionRef n, DUnionRef n'
+  | DBigarray n, DBigarray n' -> n = n'
+  | DPointer t, DPointer t'
+  | DReturns t, DReturns t' -> t == t'
+  | DStruct (tag, size, align, ms), DStruct (tag', size', align', ms')
+  | DUnion (tag, size, align, ms), DUnion (tag', size', align', ms') ->
+    tag = tag' && size = size' && align = align' && same_members ms ms'
+  | DAbstract (name, size, align), DAbstract (name', size', align') ->
+    name = name' && size = size' && align = align'
+  | DView (n, t), DView (n', t')
+  | DArray (t, n), DArray (t', n') -> n = n' && t == t'
+  | DFunction (arg, rest), DFunction (arg', rest') ->
+    arg == arg' && rest == rest'
+  | _ -> false
+
+type descriptor = t
+
+(* The interning tables hold descriptors weakly, so a descriptor is
+   collected along with the last type value or table key that refers to it.
+   The tables are not protected by a lock: interning the same type from
+   several threads at once may produce two descriptors for it. *)
+module Descriptors = Weak.Make(struct
+  type t = descriptor
+  let equal l r = same_descr l.descr r.descr
+  (* Views share the fingerprint of the underlying type. *)
+  let hash = function
+    | { descr = DView (serial, _); fingerprint } ->
+      Hashtbl.hash (serial, fingerprint)
+    | { fingerprint } -> Hashtbl.hash fingerprint
+end)
+
+module Ids = Weak.Make(struct
+  type t = descriptor
+  let equal l r = l.id = r.id
+  let hash { id } = id
+end)
+
+let table = Descriptors.create 64
+let by_id = Ids.create 64
+let next_id = ref 0
+let next_serial = ref 0
+
+let intern d =
+  let probe = { id = -1; fingerprint = fingerprint_of_descr d; descr = d } in
+  try Descriptors.find table probe
+  with Not_found ->
+    let t = { probe with id = !next_id } in
+    begin
+      incr next_id;
+      Descriptors.add table t;
+      Ids.add by_id t;
+      t
+    end
+
+(* The cache holds only the id, so the descriptor is recomputed if it has
+   been collected since. *)
+let cached cache compute =
+  let recompute () = let t = compute () in (cache.cid <- t.id; t) in
+  if cache.cid < 0 then recompute ()
+  else
+    try Ids.find by_id { id = cache.cid; fingerprint = 0L; descr = DVoid }
+    with Not_found -> recompute ()
+
+let serial cache =
+  if cache.cserial < 0 then begin
+    cache.cserial <- !next_serial;
+    incr next_serial
+  end;
+  cache.cserial
+
+let rec of_typ : type a. a typ -> t = function
+  | Void -> intern DVoid
+  | Primitive (Primitives.Long_as_int | Primitives.Llong_as_int
+              | Primitives.Size_t_as_int as p) ->
+    intern (DPrimitive_as_int (Ctypes_primitives.name p))
+  | Primitive p -> intern (DPrimitive (Ctypes_primitives.name p))
+  | Pointer ty -> intern (DPointer (referent ty))
+  | Struct { spec = Incomplete _ } -> raise IncompleteType
+  | Struct { tag; spec = Complete { size; align }; fields } ->
+    intern (DStruct (tag, size, align, members fields))
+  | Union { uspec = None } -> raise IncompleteType
+  | Union { utag; uspec = Some { size; align }; ufields } ->
+    intern (DUnion (utag, size, align, members ufields))
+  | Abstract { aname; asize; aalignment } ->
+    intern (DAbstract (aname, asize, aalignment))
+  | View { ty; vcache } ->
+    cached vcache (fun () -> intern (DView (serial vcache, of_typ ty)))
+  | Array (ty, n, cache) ->
+    cached cache (fun () -> intern (DArray (of_typ ty, n)))
+  | Bigarray ba -> intern (DBigarray (Ctypes_bigarray.descriptor ba))
+
+(* The descriptor of a type reached through a pointer, where structs and
+   unions may be incomplete. *)
+and referent : type a. a typ -> t = function
+  | Struct { tag } -> intern (DStructRef tag)
+  | Union { utag } -> intern (DUnionRef utag)
+  | Pointer ty -> intern (DPointer (referent ty))
+  | View { ty; vcache } -> intern (DView (serial vcache, referent ty))
+  | Array (ty, n, _) -> intern (DArray (referent ty, n))
+  | ty -> of_typ ty
+
+and members : type s. s boxed_field list -> member list = fun fields ->
+  List.map
+    (function
+      | BoxedField { ftype; foffset; fname } ->
+        Field (fname, foffset, of_typ ftype)
+      | BoxedBitfield { bftype; bfoffset; bfbit; bfwidth; bfname } ->
+        Bits (bfname, bfoffset, bfbit, bfwidth, of_typ bftype))
+    fields
+
+let rec of_fn : type a. a fn -> t = function
+  | Returns ty -> intern (DReturns (of_typ ty))
+  | Function (ty, fn) -> intern (DFunction (of_typ ty, of_fn fn))
+
+let id { id } = id
+let fingerprint { fingerprint } = fingerprint
+
+(* The representation follows the fingerprint except where OCaml sees a
+   value differently from C: through a view, or as an int. *)
+let rec representation { fingerprint; descr } = match descr with
+  | DPrimitive_as_int name ->
+    mix_string (mix_string fnv_offset_basis "prim_as_int") name
+  | DView (_, t) ->
+    mix_int64 (mix_string fnv_offset_basis "view") (representation t)
+  | DReturns t ->
+    mix_int64 (mix_string fnv_offset_basis "returns") (representation t)
+  | DFunction (arg, rest) ->
+    mix_int64 (mix_int64 (mix_string fnv_offset_basis "fn")
+                 (representation arg)) (representation rest)
+  | _ -> fingerprint
+let equal l r = l.id = r.id
+let compare l r = Pervasives.compare l.id r.id
+let hash { id } = id
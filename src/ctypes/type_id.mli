@@ -0,0 +1,21 @@
+(*
+ * Copyright (c) 2014 Jeremy Yallop.
+ *
+ * This file is distributed under the terms of the MIT License.
+ * See the file LICENSE for details.
+ *)
+
+(* Hash-consed descriptors for types and function signatures. *)
+
+type t
+
+val of_typ : 'a Static.typ -> t
+val of_fn : 'a Static.fn -> t
+
+val id : t -> int
+val fingerprint : t -> int64
+val representation : t -> int64
+
+val equal : t -> t -> bool
+val compare : t -> t -> int
+val hash : t -> int
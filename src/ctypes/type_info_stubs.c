@@ -10,98 +10,297 @@
 #include <assert.h>
 #include <complex.h>
 #include <string.h>
+#include <limits.h>
 
 #include <caml/memory.h>
 #include <caml/alloc.h>
+#include <caml/fail.h>
 
 #include "unsigned_stubs.h"
 #include "complex_stubs.h"
 #include "raw_pointer.h"
 #include "primitives.h"
 
+/* Access values at addresses that need not be suitably aligned, as in packed
+   structs.  Compilers turn the fixed-size memcpy into a single load or store
+   on targets that permit unaligned access. */
+#define READ(TYPE, BUF, CONV) \
+  do { TYPE x_; memcpy(&x_, (BUF), sizeof x_); b = CONV(x_); } while (0)
+#define WRITE(TYPE, BUF, V) \
+  do { TYPE x_ = (V); memcpy((BUF), &x_, sizeof x_); } while (0)
+
+value ctypes_copy_long_as_int(long l)
+{
+  if (l < Min_long || l > Max_long)
+    caml_failwith("ctypes_copy_long_as_int");
+  return Val_long(l);
+}
+
+value ctypes_copy_llong_as_int(long long l)
+{
+  if (l < Min_long || l > Max_long)
+    caml_failwith("ctypes_copy_llong_as_int");
+  return Val_long(l);
+}
+
+value ctypes_copy_size_t_as_int(size_t s)
+{
+  if (s > (uintnat)Max_long)
+    caml_failwith("ctypes_copy_size_t_as_int");
+  return Val_long(s);
+}
+
+long ctypes_long_as_int_val(value v)
+{
+  intnat i = Long_val(v);
+  if (i < LONG_MIN || i > LONG_MAX)
+    caml_invalid_argument("ctypes_long_as_int_val");
+  return i;
+}
+
+long long ctypes_llong_as_int_val(value v)
+{
+  return Long_val(v);
+}
+
+size_t ctypes_size_t_as_int_val(value v)
+{
+  intnat i = Long_val(v);
+  if (i < 0 || (uintnat)i > SIZE_MAX)
+    caml_invalid_argument("ctypes_size_t_as_int_val");
+  return i;
+}
+
+/* Convert the C value of primitive type [prim] at [buf] to an OCaml value */
+static value ctypes_read_prim(int prim, void *buf)
+{
+  value b = Val_unit;
+  switch (prim)
+  {
+   case Char: READ(char, buf, Val_int); break;
+   case Schar: READ(signed char, buf, Val_int); break;
+   case Uchar: READ(unsigned char, buf, ctypes_copy_uint8); break;
+   case Short: READ(short, buf, Val_int); break;
+   case Int: READ(int, buf, Val_int); break;
+   case Long: READ(long, buf, ctypes_copy_long); break;
+   case Llong: READ(long long, buf, ctypes_copy_llong); break;
+   case Ushort: READ(unsigned short, buf, ctypes_copy_ushort); break;
+   case Uint: READ(unsigned int, buf, ctypes_copy_uint); break;
+   case Ulong: READ(unsigned long, buf, ctypes_copy_ulong); break;
+   case Ullong: READ(unsigned long long, buf, ctypes_copy_ullong); break;
+   case Size_t: READ(size_t, buf, ctypes_copy_size_t); break;
+   case Int8_t: READ(int8_t, buf, Val_int); break;
+   case Int16_t: READ(int16_t, buf, Val_int); break;
+   case Int32_t: READ(int32_t, buf, caml_copy_int32); break;
+   case Int64_t: READ(int64_t, buf, caml_copy_int64); break;
+   case Uint8_t: READ(uint8_t, buf, ctypes_copy_uint8); break;
+   case Uint16_t: READ(uint16_t, buf, ctypes_copy_uint16); break;
+   case Uint32_t: READ(uint32_t, buf, ctypes_copy_uint32); break;
+   case Uint64_t: READ(uint64, buf, ctypes_copy_uint64); break;
+   case Camlint: READ(intnat, buf, Val_int); break;
+   case Nativeint: READ(intnat, buf, caml_copy_nativeint); break;
+   case Float: READ(float, buf, caml_copy_double); break;
+   case Double: READ(double, buf, caml_copy_double); break;
+   case Complex32: READ(float complex, buf, ctypes_copy_float_complex); break;
+   case Complex64: READ(double complex, buf, ctypes_copy_double_complex); break;
+   case Long_as_int: READ(long, buf, ctypes_copy_long_as_int); break;
+   case Llong_as_int: READ(long long, buf, ctypes_copy_llong_as_int); break;
+   case Size_t_as_int: READ(size_t, buf, ctypes_copy_size_t_as_int); break;
+   default:
+    assert(0);
+  }
+  return b;
+}
+
 /* Read a C value from a block of memory */
 /* read : 'a prim -> offset:int -> raw_pointer -> 'a */
 value ctypes_read(value prim_, value offset_, value buffer_)
 {
   CAMLparam3(prim_, offset_, buffer_);
-  CAMLlocal1(b);
   int offset = Int_val(offset_);
   void *buf = (char *)CTYPES_TO_PTR(buffer_) + offset;
-  switch (Int_val(prim_))
+  CAMLreturn(ctypes_read_prim(Int_val(prim_), buf));
+}
+
+/* Store the OCaml value [v] at [buf] as a C value of primitive type [prim] */
+static void ctypes_write_prim(int prim, value v, void *buf)
+{
+  switch (prim)
   {
-   case Char: b = Val_int(*(char *)buf); break;
-   case Schar: b = Val_int(*(signed char *)buf); break;
-   case Uchar: b = ctypes_copy_uint8(*(unsigned char *)buf); break;
-   case Short: b = Val_int(*(short *)buf); break;
-   case Int: b = Val_int(*(int *)buf); break;
-   case Long: b = ctypes_copy_long(*(long *)buf); break;
-   case Llong: b = ctypes_copy_llong(*(long long *)buf); break;
-   case Ushort: b = ctypes_copy_ushort(*(unsigned short *)buf); break;
-   case Uint: b = ctypes_copy_uint(*(unsigned int *)buf); break;
-   case Ulong: b = ctypes_copy_ulong(*(unsigned long *)buf); break;
-   case Ullong: b = ctypes_copy_ullong(*(unsigned long long *)buf); break;
-   case Size_t: b = ctypes_copy_size_t(*(size_t *)buf); break;
-   case Int8_t: b = Val_int(*(int8_t *)buf); break;
-   case Int16_t: b = Val_int(*(int16_t *)buf); break;
-   case Int32_t: b = caml_copy_int32(*(int32_t *)buf); break;
-   case Int64_t: b = caml_copy_int64(*(int64_t *)buf); break;
-   case Uint8_t: b = ctypes_copy_uint8(*(uint8_t *)buf); break;
-   case Uint16_t: b = ctypes_copy_uint16(*(uint16_t *)buf); break;
-   case Uint32_t: b = ctypes_copy_uint32(*(uint32_t *)buf); break;
-   case Uint64_t: b = ctypes_copy_uint64(*(uint64 *)buf); break;
-   case Camlint: b = Val_int(*(intnat *)buf); break;
-   case Nativeint: b = caml_copy_nativeint(*(intnat *)buf); break;
-   case Float: b = caml_copy_double(*(float *)buf); break;
-   case Double: b = caml_copy_double(*(double *)buf); break;
-   case Complex32: b = ctypes_copy_float_complex(*(float complex *)buf); break;
-   case Complex64: b = ctypes_copy_double_complex(*(double complex *)buf); break;
+   case Char: WRITE(char, buf, Int_val(v)); break;
+   case Schar: WRITE(signed char, buf, Int_val(v)); break;
+   case Uchar: WRITE(unsigned char, buf, Uint8_val(v)); break;
+   case Short: WRITE(short, buf, Int_val(v)); break;
+   case Int: WRITE(int, buf, Int_val(v)); break;
+   case Long: WRITE(long, buf, ctypes_long_val(v)); break;
+   case Llong: WRITE(long long, buf, ctypes_llong_val(v)); break;
+   case Ushort: WRITE(unsigned short, buf, ctypes_ushort_val(v)); break;
+   case Uint: WRITE(unsigned int, buf, ctypes_uint_val(v)); break;
+   case Ulong: WRITE(unsigned long, buf, ctypes_ulong_val(v)); break;
+   case Ullong: WRITE(unsigned long long, buf, ctypes_ullong_val(v)); break;
+   case Size_t: WRITE(size_t, buf, ctypes_size_t_val(v)); break;
+   case Int8_t: WRITE(int8_t, buf, Int_val(v)); break;
+   case Int16_t: WRITE(int16_t, buf, Int_val(v)); break;
+   case Int32_t: WRITE(int32_t, buf, Int32_val(v)); break;
+   case Int64_t: WRITE(int64_t, buf, Int64_val(v)); break;
+   case Uint8_t: WRITE(uint8_t, buf, Uint8_val(v)); break;
+   case Uint16_t: WRITE(uint16_t, buf, Uint16_val(v)); break;
+   case Uint32_t: WRITE(uint32_t, buf, Uint32_val(v)); break;
+   case Uint64_t: WRITE(uint64, buf, Uint64_val(v)); break;
+   case Camlint: WRITE(intnat, buf, Int_val(v)); break;
+   case Nativeint: WRITE(intnat, buf, Nativeint_val(v)); break;
+   case Float: WRITE(float, buf, Double_val(v)); break;
+   case Double: WRITE(double, buf, Double_val(v)); break;
+   case Complex32: WRITE(float complex, buf, ctypes_float_complex_val(v)); break;
+   case Complex64: WRITE(double complex, buf, ctypes_double_complex_val(v)); break;
+   case Long_as_int: WRITE(long, buf, ctypes_long_as_int_val(v)); break;
+   case Llong_as_int: WRITE(long long, buf, ctypes_llong_as_int_val(v)); break;
+   case Size_t_as_int: WRITE(size_t, buf, ctypes_size_t_as_int_val(v)); break;
    default:
     assert(0);
   }
-  CAMLreturn(b);
 }
 
-/* Read a C value from a block of memory */
+/* Write a C value to a block of memory */
 /* write : 'a prim -> offset:int -> 'a -> raw_pointer -> unit */
 value ctypes_write(value prim_, value offset_, value v, value buffer_)
 {
   CAMLparam4(prim_, offset_, v, buffer_);
   int offset = Int_val(offset_);
   void *buf = (char *)CTYPES_TO_PTR(buffer_) + offset;
-  switch (Int_val(prim_))
+  ctypes_write_prim(Int_val(prim_), v, buf);
+  CAMLreturn(Val_unit);
+}
+
+/* The size and signedness of the integer types that can hold bitfields */
+static size_t bitfield_unit(int prim, int *is_signed)
+{
+  switch (prim)
   {
-   case Char: *(char *)buf = Int_val(v); break;
-   case Schar: *(signed char *)buf = Int_val(v); break;
-   case Uchar: *(unsigned char *)buf = Uint8_val(v); break;
-   case Short: *(short *)buf = Int_val(v); break;
-   case Int: *(int *)buf = Int_val(v); break;
-   case Long: *(long *)buf = ctypes_long_val(v); break;
-   case Llong: *(long long *)buf = ctypes_llong_val(v); break;
-   case Ushort: *(unsigned short *)buf = ctypes_ushort_val(v); break;
-   case Uint: *(unsigned int *)buf = ctypes_uint_val(v); break;
-   case Ulong: *(unsigned long *)buf = ctypes_ulong_val(v); break;
-   case Ullong: *(unsigned long long *)buf = ctypes_ullong_val(v); break;
-   case Size_t: *(size_t *)buf = ctypes_size_t_val(v); break;
-   case Int8_t: *(int8_t *)buf = Int_val(v); break;
-   case Int16_t: *(int16_t *)buf = Int_val(v); break;
-   case Int32_t: *(int32_t *)buf = Int32_val(v); break;
-   case Int64_t: *(int64_t *)buf = Int64_val(v); break;
-   case Uint8_t: *(uint8_t *)buf = Uint8_val(v); break;
-   case Uint16_t: *(uint16_t *)buf = Uint16_val(v); break;
-   case Uint32_t: *(uint32_t *)buf = Uint32_val(v); break;
-   case Uint64_t: *(uint64 *)buf = Uint64_val(v); break;
-   case Camlint: *(intnat *)buf = Int_val(v); break;
-   case Nativeint: *(intnat *)buf = Nativeint_val(v); break;
-   case Float: *(float *)buf = Double_val(v); break;
-   case Double: *(double *)buf = Double_val(v); break;
-   case Complex32: *(float complex *)buf = ctypes_float_complex_val(v); break;
-   case Complex64: *(double complex *)buf = ctypes_double_complex_val(v); break;
+   case Char: *is_signed = CHAR_MIN < 0; return sizeof(char);
+   case Schar: *is_signed = 1; return sizeof(signed char);
+   case Uchar: *is_signed = 0; return sizeof(unsigned char);
+   case Short: *is_signed = 1; return sizeof(short);
+   case Int: *is_signed = 1; return sizeof(int);
+   case Long: *is_signed = 1; return sizeof(long);
+   case Llong: *is_signed = 1; return sizeof(long long);
+   case Ushort: *is_signed = 0; return sizeof(unsigned short);
+   case Uint: *is_signed = 0; return sizeof(unsigned int);
+   case Ulong: *is_signed = 0; return sizeof(unsigned long);
+   case Ullong: *is_signed = 0; return sizeof(unsigned long long);
+   case Size_t: *is_signed = 0; return sizeof(size_t);
+   case Int8_t: *is_signed = 1; return sizeof(int8_t);
+   case Int16_t: *is_signed = 1; return sizeof(int16_t);
+   case Int32_t: *is_signed = 1; return sizeof(int32_t);
+   case Int64_t: *is_signed = 1; return sizeof(int64_t);
+   case Uint8_t: *is_signed = 0; return sizeof(uint8_t);
+   case Uint16_t: *is_signed = 0; return sizeof(uint16_t);
+   case Uint32_t: *is_signed = 0; return sizeof(uint32_t);
+   case Uint64_t: *is_signed = 0; return sizeof(uint64_t);
+   case Long_as_int: *is_signed = 1; return sizeof(long);
+   case Llong_as_int: *is_signed = 1; return sizeof(long long);
+   case Size_t_as_int: *is_signed = 0; return sizeof(size_t);
    default:
     assert(0);
+    return 0;
+  }
+}
+
+/* Copy an integer of [size] bytes to or from a temporary */
+static uint64_t load_unit(const void *buf, size_t size)
+{
+  switch (size)
+  {
+   case 1: { uint8_t u; memcpy(&u, buf, sizeof u); return u; }
+   case 2: { uint16_t u; memcpy(&u, buf, sizeof u); return u; }
+   case 4: { uint32_t u; memcpy(&u, buf, sizeof u); return u; }
+   case 8: { uint64_t u; memcpy(&u, buf, sizeof u); return u; }
+   default: assert(0); return 0;
+  }
+}
+
+static void store_unit(void *buf, size_t size, uint64_t u)
+{
+  switch (size)
+  {
+   case 1: { uint8_t v = u; memcpy(buf, &v, sizeof v); break; }
+   case 2: { uint16_t v = u; memcpy(buf, &v, sizeof v); break; }
+   case 4: { uint32_t v = u; memcpy(buf, &v, sizeof v); break; }
+   case 8: { uint64_t v = u; memcpy(buf, &v, sizeof v); break; }
+   default: assert(0);
+  }
+}
+
+#define BITFIELD_MASK(WIDTH) \
+  ((WIDTH) >= 64 ? ~(uint64_t)0 : ((uint64_t)1 << (WIDTH)) - 1)
+
+/* Bits are allocated from the least significant end of the first byte on
+   little-endian targets and from the most significant end on big-endian
+   targets.  Copying the bytes that hold a bitfield into the start of a
+   64-bit integer therefore places the bitfield at the following shift. */
+#ifdef ARCH_BIG_ENDIAN
+#define BITFIELD_SHIFT(BIT, WIDTH) (64 - (BIT) - (WIDTH))
+#else
+#define BITFIELD_SHIFT(BIT, WIDTH) (BIT)
+#endif
+
+/* Only the bytes that hold the bitfield are accessed, so the access never
+   extends beyond the enclosing struct, even when the struct is packed. */
+#define BITFIELD_BYTES(BIT, WIDTH) (((BIT) + (WIDTH) + 7) / 8)
+
+/* Read a bitfield from a block of memory */
+/* read_bitfield : 'a prim -> offset:int -> bit:int -> width:int ->
+                   raw_pointer -> 'a */
+value ctypes_read_bitfield(value prim_, value offset_, value bit_,
+                           value width_, value buffer_)
+{
+  CAMLparam5(prim_, offset_, bit_, width_, buffer_);
+  int prim = Int_val(prim_), bit = Int_val(bit_), width = Int_val(width_);
+  int is_signed;
+  size_t size = bitfield_unit(prim, &is_signed);
+  void *buf = (char *)CTYPES_TO_PTR(buffer_) + Int_val(offset_);
+  uint64_t bits = 0, tmp = 0;
+  if (width > 0) {
+    memcpy(&bits, buf, BITFIELD_BYTES(bit, width));
+    bits = (bits >> BITFIELD_SHIFT(bit, width)) & BITFIELD_MASK(width);
+    if (is_signed && (bits >> (width - 1)) & 1)
+      bits |= ~BITFIELD_MASK(width);
+  }
+  store_unit(&tmp, size, bits);
+  CAMLreturn(ctypes_read_prim(prim, &tmp));
+}
+
+/* Write a bitfield to a block of memory */
+/* write_bitfield : 'a prim -> offset:int -> bit:int -> width:int ->
+                    'a -> raw_pointer -> unit */
+value ctypes_write_bitfield(value prim_, value offset_, value bit_,
+                            value width_, value v, value buffer_)
+{
+  CAMLparam5(prim_, offset_, bit_, width_, v);
+  CAMLxparam1(buffer_);
+  int prim = Int_val(prim_), bit = Int_val(bit_), width = Int_val(width_);
+  int is_signed;
+  size_t size = bitfield_unit(prim, &is_signed);
+  void *buf = (char *)CTYPES_TO_PTR(buffer_) + Int_val(offset_);
+  uint64_t bits = 0, tmp = 0, mask;
+  if (width > 0) {
+    size_t nbytes = BITFIELD_BYTES(bit, width);
+    int shift = BITFIELD_SHIFT(bit, width);
+    mask = BITFIELD_MASK(width) << shift;
+    ctypes_write_prim(prim, v, &tmp);
+    memcpy(&bits, buf, nbytes);
+    bits = (bits & ~mask) | ((load_unit(&tmp, size) << shift) & mask);
+    memcpy(buf, &bits, nbytes);
   }
   CAMLreturn(Val_unit);
 }
 
+value ctypes_write_bitfield_byte6(value *argv, int argc)
+{
+  return ctypes_write_bitfield(argv[0], argv[1], argv[2],
+                               argv[3], argv[4], argv[5]);
+}
+
 /* Format a C value */
 /* string_of_prim : 'a prim -> 'a -> string */
 value ctypes_string_of_prim(value prim_, value v)
@@ -136,6 +335,10 @@ value ctypes_string_of_prim(value prim_, value v)
                          (intnat)Int_val(v)); break;
   case Nativeint: len = snprintf(buf, sizeof buf, "%" ARCH_INTNAT_PRINTF_FORMAT "d",
                            (intnat)Nativeint_val(v)); break;
+  case Long_as_int:
+  case Llong_as_int:
+  case Size_t_as_int: len = snprintf(buf, sizeof buf, "%" ARCH_INTNAT_PRINTF_FORMAT "d",
+                               (intnat)Long_val(v)); break;
   case Float: len = snprintf(buf, sizeof buf, "%.12g", Double_val(v)); break;
   case Double: len = snprintf(buf, sizeof buf, "%.12g", Double_val(v)); break;
   case Complex32: {
@@ -161,7 +364,9 @@ value ctypes_read_pointer(value offset_, value src_)
 {
   CAMLparam2(offset_, src_);
   void *src = (char *)CTYPES_TO_PTR(src_) + Int_val(offset_);
-  CAMLreturn(CTYPES_FROM_PTR(*(void **)src));
+  void *p;
+  memcpy(&p, src, sizeof p);
+  CAMLreturn(CTYPES_FROM_PTR(p));
 }
 
 /* write_pointer : offset:int -> raw_pointer -> dst:raw_pointer -> unit */
@@ -169,7 +374,8 @@ value ctypes_write_pointer(value offset_, value p_, value dst_)
 {
   CAMLparam3(offset_, p_, dst_);
   void *dst = (char *)CTYPES_TO_PTR(dst_) + Int_val(offset_);
-  *(void **)dst = CTYPES_TO_PTR(p_);
+  void *p = CTYPES_TO_PTR(p_);
+  memcpy(dst, &p, sizeof p);
   CAMLreturn(Val_unit);
 }
 
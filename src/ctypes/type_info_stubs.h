@@ -18,4 +18,17 @@ extern value ctypes_read(value ctype, value offset, value buffer);
 /* write : 'a prim -> offset:int -> 'a -> raw_pointer -> unit */
 extern value ctypes_write(value ctype, value offset, value v, value buffer);
 
+/* Read a bitfield from a block of memory */
+/* read_bitfield : 'a prim -> offset:int -> bit:int -> width:int ->
+                   raw_pointer -> 'a */
+extern value ctypes_read_bitfield(value ctype, value offset, value bit,
+                                  value width, value buffer);
+
+/* Write a bitfield to a block of memory */
+/* write_bitfield : 'a prim -> offset:int -> bit:int -> width:int ->
+                    'a -> raw_pointer -> unit */
+extern value ctypes_write_bitfield(value ctype, value offset, value bit,
+                                   value width, value v, value buffer);
+extern value ctypes_write_bitfield_byte6(value *argv, int argc);
+
 #endif /* TYPE_INFO_STUBS_H */
@@ -66,7 +66,7 @@ let rec format_typ : type a. a typ ->
             | `array -> fprintf fmt "(*%t)" (k `nonarray)
             | _      -> fprintf fmt "*%t" (k `nonarray))
         `nonarray fmt
-    | Array (ty, n) ->
+    | Array (ty, n, _) ->
       format_typ ty (fun _ fmt -> fprintf fmt "%t[%d]" (k `array) n) `nonarray
         fmt
     | Bigarray ba ->
@@ -80,10 +80,16 @@ and format_fields : type a. a boxed_field list -> Format.formatter -> unit =
   fun fields fmt ->
   let open Format in
       List.iteri
-        (fun i (BoxedField {ftype=t; fname}) ->
-          fprintf fmt "@[";
-          format_typ t (fun _ fmt -> fprintf fmt " %s" fname) `nonarray fmt;
-          fprintf fmt "@];@;")
+        (fun i -> function
+          | BoxedField {ftype=t; fname} ->
+            fprintf fmt "@[";
+            format_typ t (fun _ fmt -> fprintf fmt " %s" fname) `nonarray fmt;
+            fprintf fmt "@];@;"
+          | BoxedBitfield {bftype=t; bfname; bfwidth} ->
+            fprintf fmt "@[";
+            format_typ t (fun _ fmt -> fprintf fmt " %s : %d" bfname bfwidth)
+              `nonarray fmt;
+            fprintf fmt "@];@;")
         fields
 and format_parameter_list parameters k fmt =
   Format.fprintf fmt "%t(@[@[" k;
@@ -107,6 +113,16 @@ and format_fn' : 'a. 'a fn ->
     format_typ r (fun context fmt -> format_parameter_list ps k fmt)
       `nonarray fmt
 
+(* The declaration of a struct or union member, e.g. "int x[3]" *)
+let string_of_member ?width name ty =
+  Common.string_of
+    (fun fmt ty ->
+      format_typ ty (fun _ fmt -> Format.fprintf fmt " %s" name) `nonarray fmt;
+      match width with
+      | Some w -> Format.fprintf fmt " : %d" w
+      | None -> ())
+    ty
+
 let format_name ?name fmt =
   match name with
     | Some name -> Format.fprintf fmt " %s" name
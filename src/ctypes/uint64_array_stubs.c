@@ -0,0 +1,72 @@
+/*
+ * Copyright (c) 2014 Jeremy Yallop.
+ *
+ * This file is distributed under the terms of the MIT License.
+ * See the file LICENSE for details.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <caml/mlvalues.h>
+
+#include "raw_pointer.h"
+
+/* The order here must correspond to the constructor order in
+   memory_stubs.ml */
+enum uint64_binop { Add, Sub, Mul, Logand, Logor, Logxor, Equal, Less };
+enum uint64_shift { Shift_left, Shift_right };
+
+/* Each operation is a separate loop with no calls or branches in the body,
+   which the compiler vectorizes at -O3 wherever the target has a
+   corresponding vector instruction.  The destination may be the same array
+   as an operand. */
+#define ELEMENTWISE(EXPR)                                 \
+  for (i = 0; i < n; i++) {                               \
+    uint64_t x = a[i], y = b[i];                          \
+    d[i] = (EXPR);                                        \
+  }                                                       \
+  break
+
+/* The comparisons produce masks: all ones where the comparison holds and
+   all zeros elsewhere. */
+#define MASK(COND) ((uint64_t)0 - (uint64_t)(COND))
+
+/* uint64_binop : binop -> dst:raw_pointer -> raw_pointer -> raw_pointer ->
+                  count:int -> unit */
+value ctypes_uint64_binop(value op_, value dst_, value a_, value b_,
+                          value count_)
+{
+  uint64_t *d = CTYPES_TO_PTR(dst_);
+  const uint64_t *a = CTYPES_TO_PTR(a_), *b = CTYPES_TO_PTR(b_);
+  size_t i, n = Long_val(count_);
+  switch (Int_val(op_))
+  {
+  case Add: ELEMENTWISE(x + y);
+  case Sub: ELEMENTWISE(x - y);
+  case Mul: ELEMENTWISE(x * y);
+  case Logand: ELEMENTWISE(x & y);
+  case Logor: ELEMENTWISE(x | y);
+  case Logxor: ELEMENTWISE(x ^ y);
+  case Equal: ELEMENTWISE(MASK(x == y));
+  case Less: ELEMENTWISE(MASK(x < y));
+  }
+  return Val_unit;
+}
+
+/* uint64_shift : shift -> dst:raw_pointer -> raw_pointer -> int ->
+                  count:int -> unit */
+value ctypes_uint64_shift(value op_, value dst_, value a_, value shift_,
+                          value count_)
+{
+  uint64_t *d = CTYPES_TO_PTR(dst_);
+  const uint64_t *a = CTYPES_TO_PTR(a_);
+  unsigned shift = Int_val(shift_);
+  size_t i, n = Long_val(count_);
+  switch (Int_val(op_))
+  {
+  case Shift_left: for (i = 0; i < n; i++) d[i] = a[i] << shift; break;
+  case Shift_right: for (i = 0; i < n; i++) d[i] = a[i] >> shift; break;
+  }
+  return Val_unit;
+}
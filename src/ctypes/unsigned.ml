@@ -90,67 +90,86 @@ struct
 end
 
 
-module UInt8 : S = 
+(* Unsigned types that fit in an OCaml int are represented as immediate
+   integers, with arithmetic carried out in OCaml.  The representation must
+   agree with the accessors in unsigned_stubs.h. *)
+module Immediate (Size : sig
+  val bits : int
+  val of_string : string -> int
+end) : Basics with type t = int =
+struct
+  type t = int
+  let max_int = (1 lsl Size.bits) - 1
+  let add x y = (x + y) land max_int
+  let sub x y = (x - y) land max_int
+  let mul x y = (x * y) land max_int
+  let div (x : t) (y : t) = x / y
+  let rem (x : t) (y : t) = x mod y
+  let logand (x : t) (y : t) = x land y
+  let logor (x : t) (y : t) = x lor y
+  let logxor (x : t) (y : t) = x lxor y
+  let shift_left x y = (x lsl y) land max_int
+  let shift_right (x : t) y = x lsr y
+  let of_int x = x land max_int
+  let to_int (x : t) = x
+  let of_string = Size.of_string
+  let to_string = string_of_int
+end
+
+
+module ImmediateExtras (B : Basics with type t = int) =
 struct
-  module B =
-  struct
-    type t
-    external add : t -> t -> t = "ctypes_uint8_add"
-    external sub : t -> t -> t = "ctypes_uint8_sub"
-    external mul : t -> t -> t = "ctypes_uint8_mul"
-    external div : t -> t -> t = "ctypes_uint8_div"
-    external rem : t -> t -> t = "ctypes_uint8_rem"
-    external logand : t -> t -> t = "ctypes_uint8_logand"
-    external logor : t -> t -> t = "ctypes_uint8_logor"
-    external logxor : t -> t -> t = "ctypes_uint8_logxor"
-    external shift_left : t -> int -> t = "ctypes_uint8_shift_left"
-    external shift_right : t -> int -> t = "ctypes_uint8_shift_right"
-    external of_int : int -> t = "ctypes_uint8_of_int"
-    external to_int : t -> int = "ctypes_uint8_to_int"
-    external of_string : string -> t = "ctypes_uint8_of_string"
-    external to_string : t -> string = "ctypes_uint8_to_string"
-    external _max_int : unit -> t = "ctypes_uint8_max"
-    let max_int = _max_int ()
-  end
-  include B
   include Extras(B)
+  let compare (x : int) (y : int) = Pervasives.compare x y
+end
+
+
+module UInt8 : S =
+struct
+  module B = Immediate(struct
+    let bits = 8
+    external of_string : string -> int = "ctypes_uint8_of_string"
+  end)
+  include B
+  include ImmediateExtras(B)
   module Infix = MakeInfix(B)
 end
 
 
 module UInt16 : S =
 struct
-  module B =
-  struct
-    type t
-    external add : t -> t -> t = "ctypes_uint16_add"
-    external sub : t -> t -> t = "ctypes_uint16_sub"
-    external mul : t -> t -> t = "ctypes_uint16_mul"
-    external div : t -> t -> t = "ctypes_uint16_div"
-    external rem : t -> t -> t = "ctypes_uint16_rem"
-    external logand : t -> t -> t = "ctypes_uint16_logand"
-    external logor : t -> t -> t = "ctypes_uint16_logor"
-    external logxor : t -> t -> t = "ctypes_uint16_logxor"
-    external shift_left : t -> int -> t = "ctypes_uint16_shift_left"
-    external shift_right : t -> int -> t = "ctypes_uint16_shift_right"
-    external of_int : int -> t = "ctypes_uint16_of_int"
-    external to_int : t -> int = "ctypes_uint16_to_int"
-    external of_string : string -> t = "ctypes_uint16_of_string"
-    external to_string : t -> string = "ctypes_uint16_to_string"
-    external _max_int : unit -> t = "ctypes_uint16_max"
-    let max_int = _max_int ()
-  end
+  module B = Immediate(struct
+    let bits = 16
+    external of_string : string -> int = "ctypes_uint16_of_string"
+  end)
   include B
-  include Extras(B)
+  include ImmediateExtras(B)
   module Infix = MakeInfix(B)
 end
 
 
-module UInt32 : sig
+module type UInt32_S = sig
   include S
-  external of_int32 : int32 -> t = "ctypes_uint32_of_int32"
-  external to_int32 : t -> int32 = "ctypes_int32_of_uint32"
-end = 
+  val of_int32 : int32 -> t
+  val to_int32 : t -> int32
+end
+
+
+module UInt32_immediate : UInt32_S =
+struct
+  module B = Immediate(struct
+    let bits = 32
+    external of_string : string -> int = "ctypes_uint32_of_string"
+  end)
+  include B
+  include ImmediateExtras(B)
+  module Infix = MakeInfix(B)
+  let of_int32 i = Int32.to_int i land max_int
+  let to_int32 = Int32.of_int
+end
+
+
+module UInt32_boxed : UInt32_S =
 struct
   module B =
   struct
@@ -180,6 +199,12 @@ struct
 end
 
 
+(* uint32_t fits in an immediate integer only on 64-bit platforms. *)
+module UInt32 : UInt32_S =
+  (val (if Sys.word_size = 64 then (module UInt32_immediate : UInt32_S)
+        else (module UInt32_boxed : UInt32_S)) : UInt32_S)
+
+
 module UInt64 : sig
   include S
   external of_int64 : int64 -> t = "ctypes_uint64_of_int64"
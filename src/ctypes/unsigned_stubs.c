@@ -16,19 +16,22 @@
 #include <limits.h>
 #include <stdio.h>
 
+#include "unsigned_stubs.h"
+
 #define Uint_custom_val(TYPE, V) (*((TYPE *) Data_custom_val(V)))
 #define TYPE(SIZE) uint ## SIZE ## _t
+#define UINT_VAL(SIZE, V) Uint ## SIZE ## _val(V)
 #define BUF_SIZE(TYPE) ((sizeof(TYPE) * CHAR_BIT + 2) / 3 + 1)
 
 #define UINT_PRIMOP(NAME, SIZE, OP)                                        \
   /* OP : t -> t -> t */                                                   \
   value ctypes_uint ## SIZE ## _ ## NAME(value a, value b)                 \
   {                                                                        \
-    return ctypes_copy_uint ## SIZE(Uint_custom_val(TYPE(SIZE), a)         \
-                                 OP Uint_custom_val(TYPE(SIZE), b));       \
+    return ctypes_copy_uint ## SIZE(UINT_VAL(SIZE, a) OP UINT_VAL(SIZE, b)); \
   }
 
-#define UINT_DEFS(BITS, BYTES)                                               \
+/* Custom block operations for the unsigned types that are boxed. */
+#define UINT_CUSTOM_DEFS(BITS, BYTES)                                        \
   static int uint ## BITS ## _cmp(value v1, value v2)                        \
   {                                                                          \
     TYPE(BITS) u1 = Uint_custom_val(TYPE(BITS), v1);                         \
@@ -70,7 +73,10 @@
     value res = caml_alloc_custom(&caml_uint ## BITS ## _ops, BYTES, 0, 1);  \
     Uint_custom_val(TYPE(BITS), res) = u;                                    \
     return res;                                                              \
-  }                                                                          \
+  }
+
+/* Operations that are independent of the representation. */
+#define UINT_DEFS(BITS)                                                      \
   UINT_PRIMOP(add, BITS,  +)                                                 \
   UINT_PRIMOP(sub, BITS,  -)                                                 \
   UINT_PRIMOP(mul, BITS,  *)                                                 \
@@ -81,8 +87,8 @@
   /* div : t -> t -> t */                                                    \
   value ctypes_uint ## BITS ## _div(value n_, value d_)                      \
   {                                                                          \
-    TYPE(BITS) n = Uint_custom_val(TYPE(BITS), n_);                          \
-    TYPE(BITS) d = Uint_custom_val(TYPE(BITS), d_);                          \
+    TYPE(BITS) n = UINT_VAL(BITS, n_);                                       \
+    TYPE(BITS) d = UINT_VAL(BITS, d_);                                       \
     if (d == (TYPE(BITS)) 0)                                                 \
         caml_raise_zero_divide();                                            \
     return ctypes_copy_uint ## BITS (n / d);                                 \
@@ -91,8 +97,8 @@
   /* rem : t -> t -> t */                                                    \
   value ctypes_uint ## BITS ## _rem(value n_, value d_)                      \
   {                                                                          \
-    TYPE(BITS) n = Uint_custom_val(TYPE(BITS), n_);                          \
-    TYPE(BITS) d = Uint_custom_val(TYPE(BITS), d_);                          \
+    TYPE(BITS) n = UINT_VAL(BITS, n_);                                       \
+    TYPE(BITS) d = UINT_VAL(BITS, d_);                                       \
     if (d == (TYPE(BITS)) 0)                                                 \
         caml_raise_zero_divide();                                            \
     return ctypes_copy_uint ## BITS (n % d);                                 \
@@ -101,15 +107,13 @@
   /* shift_left : t -> int -> t */                                           \
   value ctypes_uint ## BITS ## _shift_left(value a, value b)                 \
   {                                                                          \
-    return ctypes_copy_uint ## BITS(Uint_custom_val(TYPE(BITS), a)           \
-                                    << Int_val(b));                          \
+    return ctypes_copy_uint ## BITS(UINT_VAL(BITS, a) << Int_val(b));        \
   }                                                                          \
                                                                              \
   /* shift_right : t -> int -> t */                                          \
   value ctypes_uint ## BITS ## _shift_right(value a, value b)                \
   {                                                                          \
-    return ctypes_copy_uint ## BITS(Uint_custom_val(TYPE(BITS), a)           \
-                                    >> Int_val(b));                          \
+    return ctypes_copy_uint ## BITS(UINT_VAL(BITS, a) >> Int_val(b));        \
   }                                                                          \
                                                                              \
   /* of_int : int -> t */                                                    \
@@ -121,7 +125,7 @@
   /* to_int : t -> int */                                                    \
   value ctypes_uint ## BITS ## _to_int(value a)                              \
   {                                                                          \
-    return Val_int(Uint_custom_val(TYPE(BITS), a));                          \
+    return Val_int(UINT_VAL(BITS, a));                                       \
   }                                                                          \
                                                                              \
   /* of_string : string -> t */                                              \
@@ -138,7 +142,7 @@
   value ctypes_uint ## BITS ## _to_string(value a)                           \
   {                                                                          \
     char buf[BUF_SIZE(TYPE(BITS))];                                          \
-    if (sprintf(buf, "%" PRIu ## BITS , Uint_custom_val(TYPE(BITS), a)) < 0) \
+    if (sprintf(buf, "%" PRIu ## BITS , UINT_VAL(BITS, a)) < 0)              \
       caml_failwith("string_of_int");                                        \
     else                                                                     \
       return caml_copy_string(buf);                                          \
@@ -151,10 +155,15 @@
   }                                                                          \
 
 
-UINT_DEFS(8, 1)
-UINT_DEFS(16, 2)
-UINT_DEFS(32, 4)
-UINT_DEFS(64, 8)
+#ifndef CTYPES_UINT32_IMMEDIATE
+UINT_CUSTOM_DEFS(32, 4)
+#endif
+UINT_CUSTOM_DEFS(64, 8)
+
+UINT_DEFS(8)
+UINT_DEFS(16)
+UINT_DEFS(32)
+UINT_DEFS(64)
 
 value ctypes_size_t_size (value _) { return Val_int(sizeof (size_t)); }
 value ctypes_ushort_size (value _) { return Val_int(sizeof (unsigned short)); }
@@ -162,6 +171,6 @@ value ctypes_uint_size (value _) { return Val_int(sizeof (unsigned int)); }
 value ctypes_ulong_size (value _) { return Val_int(sizeof (unsigned long)); }
 value ctypes_ulonglong_size (value _) { return Val_int(sizeof (unsigned long long)); }
 value ctypes_uint32_of_int32 (value i) { return ctypes_copy_uint32(Int32_val(i)); }
-value ctypes_int32_of_uint32 (value u) { return caml_copy_int32(Uint_custom_val(uint32_t, u)); }
+value ctypes_int32_of_uint32 (value u) { return caml_copy_int32(Uint32_val(u)); }
 value ctypes_uint64_of_int64 (value i) { return ctypes_copy_uint64(Int64_val(i)); }
-value ctypes_int64_of_uint64 (value u) { return caml_copy_int64(Uint_custom_val(uint64_t, u)); }
+value ctypes_int64_of_uint64 (value u) { return caml_copy_int64(Uint64_val(u)); }
@@ -13,7 +13,6 @@
 #include <stdint.h>
 
 #define UINT_DECLS(BITS)                                                  \
-  extern value ctypes_copy_uint ## BITS(uint ## BITS ## _t u);            \
   /* uintX_add : t -> t -> t */                                           \
   extern value ctypes_uint ## BITS ## _ ## add(value a, value b);         \
   /* uintX_sub : t -> t -> t */                                           \
@@ -39,7 +38,7 @@
   /* to_int : t -> int */                                                 \
   extern value ctypes_uint ## BITS ## _to_int(value a);                   \
   /* of_string : string -> t */                                           \
-  extern value ctypes_uint ## BITS ## _of_string(value a, value b);       \
+  extern value ctypes_uint ## BITS ## _of_string(value a);                \
   /* to_string : t -> string */                                           \
   extern value ctypes_uint ## BITS ## _to_string(value a);                \
   /* max : unit -> t */                                                   \
@@ -57,9 +56,28 @@ extern value ctypes_uint_size (value _);
 extern value ctypes_ulong_size (value _);
 extern value ctypes_ulonglong_size (value _);
 
-#define Uint8_val(V) (*((uint8_t *) Data_custom_val(V)))
-#define Uint16_val(V) (*((uint16_t *) Data_custom_val(V)))
+/* Unsigned types that fit in an OCaml int are represented as immediate
+   integers; the others are custom blocks.  This must agree with the choice
+   of representation in unsigned.ml. */
+#ifdef ARCH_SIXTYFOUR
+#define CTYPES_UINT32_IMMEDIATE
+#endif
+
+#define Uint8_val(V) ((uint8_t) Long_val(V))
+#define ctypes_copy_uint8(U) Val_long((uint8_t) (U))
+
+#define Uint16_val(V) ((uint16_t) Long_val(V))
+#define ctypes_copy_uint16(U) Val_long((uint16_t) (U))
+
+#ifdef CTYPES_UINT32_IMMEDIATE
+#define Uint32_val(V) ((uint32_t) Long_val(V))
+#define ctypes_copy_uint32(U) Val_long((uint32_t) (U))
+#else
 #define Uint32_val(V) (*((uint32_t *) Data_custom_val(V)))
+extern value ctypes_copy_uint32(uint32_t u);
+#endif
+
 #define Uint64_val(V) (*((uint64_t *) Data_custom_val(V)))
+extern value ctypes_copy_uint64(uint64_t u);
 
 #endif /* CTYPES_UNMSIGNED_STUBS_H */
@@ -16,7 +16,7 @@ let rec format : type a. a typ -> Format.formatter -> a -> unit
   | Pointer _ -> format_ptr fmt v
   | Struct _ -> format_structured fmt v
   | Union _ -> format_structured fmt v
-  | Array (a, n) -> format_array fmt v
+  | Array (a, n, _) -> format_array fmt v
   | Bigarray ba -> Format.fprintf fmt "<bigarray %a>"
     (fun fmt -> Type_printing.format_typ fmt) typ
   | Abstract _ -> format_structured fmt v
@@ -53,9 +53,13 @@ and format_fields : type a b. string -> (a, b) structured boxed_field list ->
     let last_field = List.length fields - 1 in
     let open Format in
     List.iteri
-      (fun i (BoxedField ({ftype; foffset; fname} as f)) ->
-        fprintf fmt "@[%s@] = @[%a@]%s@;" fname (format ftype) (getf s f)
-          (if i <> last_field then sep else ""))
+      (fun i -> function
+        | BoxedField ({ftype; foffset; fname} as f) ->
+          fprintf fmt "@[%s@] = @[%a@]%s@;" fname (format ftype) (getf s f)
+            (if i <> last_field then sep else "")
+        | BoxedBitfield ({bftype; bfname} as f) ->
+          fprintf fmt "@[%s@] = @[%a@]%s@;" bfname (format bftype) (getbf s f)
+            (if i <> last_field then sep else ""))
       fields
 and format_ptr : type a. Format.formatter -> a ptr -> unit
   = fun fmt {raw_ptr; reftype; pbyte_offset} ->
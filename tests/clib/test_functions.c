@@ -206,6 +206,11 @@ double accepts_pointer_to_array_of_structs(struct tagged(*arr)[5])
   return sum;
 }
 
+double accepts_array_of_structs(struct tagged arr[5])
+{
+  return accepts_pointer_to_array_of_structs((struct tagged(*)[5])arr);
+}
+
 struct global_struct global_struct = { sizeof GLOBAL_STRING - 1, GLOBAL_STRING };
 
 
@@ -490,6 +495,13 @@ double *matrix_transpose(int rows, int cols, double *matrix)
   return rv;
 }
 
+void scale_doubles(int n, double k, double *xs)
+{
+  int i;
+  for (i = 0; i < n; i++)
+    xs[i] *= k;
+}
+
 int (*plus_callback)(int) = NULL;
 
 /* Sum the range [a, b] */
@@ -501,3 +513,18 @@ int sum_range_with_plus_callback(int a, int b)
   }
   return sum;
 }
+
+double halve_double(double x)
+{
+  return x / 2;
+}
+
+int64_t add_int64_int(int64_t x, int y)
+{
+  return x + y;
+}
+
+int sum_six_ints(int a, int b, int c, int d, int e, int f)
+{
+  return a + b + c + d + e + f;
+}
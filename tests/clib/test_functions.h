@@ -59,7 +59,11 @@ struct tagged {
 
 extern struct tagged add_tagged_numbers(struct tagged, struct tagged);
 
+enum fruit { Orange, Apple, Banana, Pear };
+#define TEST_NEGATIVE_CONSTANT (-37)
+
 extern double accepts_pointer_to_array_of_structs(struct tagged(*)[5]);
+extern double accepts_array_of_structs(struct tagged[5]);
 #define GLOBAL_STRING "global string"
 struct global_struct {
   size_t len;
@@ -156,7 +160,11 @@ struct one_int { int i; };
 struct one_int return_struct_by_value(void);
 void matrix_mul(int, int, int, double *, double *, double *);
 double *matrix_transpose(int, int, double *);
+void scale_doubles(int, double, double *);
 int (*plus_callback)(int);
 int sum_range_with_plus_callback(int, int);
+double halve_double(double);
+int64_t add_int64_int(int64_t, int);
+int sum_six_ints(int, int, int, int, int, int);
 
 #endif /* TEST_FUNCTIONS_H */
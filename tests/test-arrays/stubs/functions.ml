@@ -40,4 +40,8 @@ struct
   let accepts_pointer_to_array_of_structs =
     foreign "accepts_pointer_to_array_of_structs"
       (ptr (array 5 s) @-> returning double)
+
+  let accepts_array_of_structs =
+    foreign "accepts_array_of_structs"
+      (array 5 s @-> returning double)
 end
@@ -172,6 +172,29 @@ struct
     assert_equal
       (103.25 +. (-14.1) +. 12.0 +. 3.5 +. 10.0)
       sum
+
+  (*
+    Test passing an array of structs, which is passed as a pointer to its
+    first element.
+  *)
+  let test_passing_array_of_structs () =
+    let box_int x =
+      let v = make s in
+      setf v tag 'i';
+      (v @. data |-> i) <-@ x;
+      v
+    in
+    let elements = CArray.of_list s
+        [box_int 1; box_int 2; box_int 3; box_int 4; box_int 5; box_int 6] in
+    begin
+      assert_equal 15.0
+        (accepts_array_of_structs (CArray.from_ptr (CArray.start elements) 5));
+      (* An array that starts part-way through a block of memory is passed as
+         the address of its own first element. *)
+      assert_equal 20.0
+        (accepts_array_of_structs
+           (CArray.from_ptr (CArray.start elements +@ 1) 5))
+    end
 end
 
 module Foreign_tests = Common_tests(Tests_common.Foreign_binder)
@@ -192,6 +215,12 @@ let suite = "Array tests" >:::
 
    "passing pointer to array of structs (stubs)"
     >:: Stub_tests.test_passing_pointer_to_array_of_structs;
+
+   "passing array of structs (foreign)"
+    >:: Foreign_tests.test_passing_array_of_structs;
+
+   "passing array of structs (stubs)"
+    >:: Stub_tests.test_passing_array_of_structs;
   ]
 
 
@@ -21,4 +21,8 @@ struct
 
   let matrix_transpose = foreign "matrix_transpose"
     (int @-> int @-> ptr double @-> returning (ptr double))
+
+  let scale_doubles = foreign "scale_doubles"
+    (int @-> double @-> bigarray array2 (2, 3) Bigarray.float64 @->
+     returning void)
 end
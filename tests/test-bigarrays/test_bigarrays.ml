@@ -320,6 +320,82 @@ let test_ctypes_array_of_bigarray () =
   end
 
 
+(*
+  View C memory through bigarrays in Fortran layout.
+*)
+let test_fortran_layout_views () =
+  (* A 2x3 C array of rows *)
+  let a = CArray.of_list double [1.; 2.; 3.;
+                                 4.; 5.; 6.] in
+  let p = CArray.start a in
+
+  (* Viewed in Fortran layout with the dimensions reversed, the array is
+     its transpose. *)
+  let t = BA.array2_of_genarray
+      (genarray_of_ptr BA.fortran_layout [| 3; 2 |] BA.float64 p) in
+  begin
+    assert_equal 3 (BA.Array2.dim1 t);
+    assert_equal 2 (BA.Array2.dim2 t);
+    assert_equal 1. t.{1, 1};
+    assert_equal 4. t.{1, 2};
+    assert_equal 3. t.{3, 1};
+    assert_equal 6. t.{3, 2};
+
+    t.{2, 2} <- 50.;
+    assert_equal 50. (CArray.get a 4);
+  end;
+
+  (* Columns of a Fortran-layout view are contiguous sub-views *)
+  let m = genarray_of_ptr BA.fortran_layout [| 2; 3 |] BA.float64 p in
+  let col = BA.array1_of_genarray (BA.Genarray.slice_right m [| 2 |]) in
+  begin
+    assert_equal 2 (BA.Array1.dim col);
+    assert_equal 3. col.{1};
+    assert_equal 4. col.{2};
+  end;
+
+  (* The address of a Fortran-layout bigarray *)
+  assert_equal
+    (raw_address_of_ptr (to_voidp p))
+    (raw_address_of_ptr (to_voidp (genarray_start m)));
+
+  assert_raises (Invalid_argument "Ctypes.genarray_of_ptr")
+    (fun () -> genarray_of_ptr BA.c_layout [| -1 |] BA.float64 p)
+
+
+(*
+  Copy strided columns of a C array of rows to and from bigarrays.
+*)
+let test_strided_copies () =
+  (* A 2x3 C array of rows *)
+  let a = CArray.of_list double [1.; 2.; 3.;
+                                 4.; 5.; 6.] in
+  let p = CArray.start a in
+  let col = BA.Array1.create BA.float64 BA.c_layout 2 in
+  begin
+    gather_strided (p +@ 1) ~stride:3 col;
+    assert_equal 2. col.{0};
+    assert_equal 5. col.{1};
+
+    col.{0} <- 30.;
+    col.{1} <- 60.;
+    scatter_strided col (p +@ 2) ~stride:3;
+    assert_equal [1.; 2.; 30.; 4.; 5.; 60.] (CArray.to_list a);
+
+    (* Row 1 of the Fortran-layout transpose is column 0 of the array. *)
+    let t = genarray_of_ptr BA.fortran_layout [| 3; 2 |] BA.float64 p in
+    let row = BA.Array1.create BA.float64 BA.fortran_layout 2 in
+    gather_strided (genarray_start t) ~stride:3 row;
+    assert_equal 1. row.{1};
+    assert_equal 4. row.{2};
+
+    assert_raises (Invalid_argument "Ctypes.gather_strided")
+      (fun () -> gather_strided p ~stride:0 col);
+    assert_raises (Unsupported "pointer type does not match bigarray kind")
+      (fun () -> gather_strided (from_voidp float (to_voidp p)) ~stride:3 col);
+  end
+
+
 module Common_tests(S : Cstubs.FOREIGN with type 'a fn = 'a) =
 struct
   module M = Functions.Stubs(S)
@@ -357,6 +433,19 @@ struct
                             [11.; 12.; 13.; 14.; 15.]])))
 
 
+  (*
+    Test passing bigarrays directly as arguments to c functions.
+  *)
+  let test_passing_bigarrays_directly () =
+    let m = matrix [[1.; 2.; 3.];
+                    [4.; 5.; 6.]] in
+    scale_doubles 6 10.0 m;
+    assert_equal
+      [[10.; 20.; 30.];
+       [40.; 50.; 60.]]
+      (unmatrix m)
+
+
   (*
     Test returning bigarrays from c functions.
   *)
@@ -463,6 +552,128 @@ let test_ctypes_memory_lifetime_with_bigarray_reference () =
   end
 
 
+(*
+  Test allocating memory that is both a bigarray and a C array.
+*)
+let test_allocate_bigarray () =
+  let module Array = CArray in
+  let ba, a = allocate_bigarray array2 (2, 3) BA.int32 in
+  begin
+    BA.Array2.fill ba 0l;
+    ba.{1, 2} <- 5l;
+    assert_equal 5l (Array.get a 1).(2);
+    (Array.get a 0).(1) <- 7l;
+    assert_equal 7l ba.{0, 1};
+    assert_equal (raw_address_of_ptr (to_voidp (bigarray_start array2 ba)))
+      (raw_address_of_ptr (to_voidp (Array.start a)));
+  end;
+
+  (* The C array keeps the memory alive after the bigarray is unreachable. *)
+  let a =
+    let ba, a = allocate_bigarray array1 4 BA.int64 in
+    BA.Array1.fill ba 3L;
+    a in
+  begin
+    Gc.compact ();
+    assert_equal [3L; 3L; 3L; 3L] (Array.to_list a)
+  end
+
+
+(*
+  Test that memory shared between several bigarray views outlives the ctypes
+  array it was allocated through.
+*)
+let test_views_sharing_ctypes_memory () =
+  let module Array = CArray in
+  let views =
+    let a = Array.make int32_t 4 in
+    begin
+      for i = 0 to 3 do a.(i) <- Int32.of_int i done;
+      [bigarray_of_array array1 BA.int32 a;
+       bigarray_of_array array1 BA.int32 a;
+       bigarray_of_array array1 BA.int32 a]
+    end
+  in
+  match views with
+  | [v1; v2; v3] ->
+    begin
+      Gc.major ();
+      Gc.major ();
+      v1.{1} <- 10l;
+      assert_equal 10l v2.{1};
+      assert_equal 3l v3.{3};
+      (* The memory survives the collection of the other views. *)
+      Gc.compact ();
+      v3.{2} <- 20l;
+      assert_equal [0l; 10l; 20l; 3l]
+        (Array.to_list (array_of_bigarray array1 v3))
+    end
+  | _ -> assert false
+
+
+(*
+  Test transposing an array of structs into bigarray columns and back.
+*)
+let test_struct_columns () =
+  let module M = struct
+    type point
+    let point : point structure typ = structure "point"
+    let id = field point "id" int32_t
+    let flag = field point "flag" char
+    let x = field point "x" double
+    let y = field point "y" float
+    let () = seal point
+
+    let n = 5
+    let points = CArray.make point n
+    let () =
+      for i = 0 to n - 1 do
+        let p = CArray.get points i in
+        setf p id (Int32.of_int (i * 10));
+        setf p flag 'a';
+        setf p x (float_of_int i *. 1.5);
+        setf p y (float_of_int i *. 0.25);
+      done
+
+    let ids = BA.Array1.create BA.int32 BA.c_layout n
+    let xs = BA.Array1.create BA.float64 BA.c_layout n
+    let ys = BA.Array1.create BA.float32 BA.c_layout n
+
+    let () = begin
+      gather points [Column (id, ids); Column (x, xs); Column (y, ys)];
+      for i = 0 to n - 1 do
+        assert_equal (Int32.of_int (i * 10)) ids.{i};
+        assert_equal (float_of_int i *. 1.5) xs.{i};
+        assert_equal (float_of_int i *. 0.25) ys.{i};
+      done
+    end
+
+    let () = begin
+      for i = 0 to n - 1 do
+        ids.{i} <- Int32.of_int (-i);
+        xs.{i} <- float_of_int i +. 0.5;
+      done;
+      scatter [Column (id, ids); Column (x, xs)] points;
+      for i = 0 to n - 1 do
+        let p = CArray.get points i in
+        assert_equal (Int32.of_int (-i)) (getf p id);
+        assert_equal 'a' (getf p flag);
+        assert_equal (float_of_int i +. 0.5) (getf p x);
+        assert_equal (float_of_int i *. 0.25) (getf p y);
+      done
+    end
+
+    let () = begin
+      assert_raises (Unsupported "column element type does not match field type")
+        (fun () -> gather points [Column (x, ids)]);
+
+      assert_raises (Invalid_argument "Ctypes.gather")
+        (fun () -> gather points
+          [Column (id, BA.Array1.create BA.int32 BA.c_layout (n + 1))]);
+    end
+  end in ()
+
+
 module Foreign_tests = Common_tests(Tests_common.Foreign_binder)
 module Stub_tests = Common_tests(Generated_bindings)
 
@@ -474,23 +685,44 @@ let suite = "Bigarray tests" >:::
    "View bigarray-managed memory using ctypes"
     >:: test_ctypes_array_of_bigarray;
 
+   "View ctypes-managed memory in Fortran layout"
+    >:: test_fortran_layout_views;
+
+   "Copy strided rows and columns of C memory"
+    >:: test_strided_copies;
+
    "Bigarrays live at least as long as ctypes references to them"
     >:: test_bigarray_lifetime_with_ctypes_reference;
 
    "Ctypes-allocated memory lives while there's a bigarray reference to it"
     >:: test_ctypes_memory_lifetime_with_bigarray_reference;
 
+   "Allocate memory that is both a bigarray and a C array"
+    >:: test_allocate_bigarray;
+
+   "Bigarray views share ctypes-allocated memory"
+    >:: test_views_sharing_ctypes_memory;
+
    "Passing bigarrays to C (foreign)"
     >:: Foreign_tests.test_passing_bigarrays;
 
    "Passing bigarrays to C (stubs)"
     >:: Stub_tests.test_passing_bigarrays;
 
+   "Passing bigarrays directly to C (foreign)"
+    >:: Foreign_tests.test_passing_bigarrays_directly;
+
+   "Passing bigarrays directly to C (stubs)"
+    >:: Stub_tests.test_passing_bigarrays_directly;
+
    "Returning bigarrays from C (foreign)"
     >:: Foreign_tests.test_returning_bigarrays;
 
    "Returning bigarrays from C (stubs)"
     >:: Stub_tests.test_returning_bigarrays;
+
+    "Gathering and scattering struct fields"
+    >:: test_struct_columns;
   ]
 
 
@@ -11,6 +11,7 @@ let cheader = "
 #include <string.h>
 #include <ctype.h>
 #include <stdlib.h>
+#include <unistd.h>
 "
 
 let () = Tests_common.run ~cheader Sys.argv (module Functions.Stubs)
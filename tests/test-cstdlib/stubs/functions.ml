@@ -10,7 +10,7 @@
 open Ctypes
 open Foreign
 
-module Stubs (F: Cstubs.FOREIGN) =
+module Stubs (F: Cstubs.FOREIGN_EXT) =
 struct
   open F
 
@@ -31,6 +31,28 @@ struct
   and isupper = foreign "isupper" t
   and isxdigit = foreign "isxdigit" t
 
+  (* The character classification functions never call back into OCaml, so
+     they can also be bound as noalloc externals. *)
+  let isalnum_noalloc = foreign_ext ~noalloc:true "isalnum" t
+  and isalpha_noalloc = foreign_ext ~noalloc:true "isalpha" t
+  and iscntrl_noalloc = foreign_ext ~noalloc:true "iscntrl" t
+  and isdigit_noalloc = foreign_ext ~noalloc:true "isdigit" t
+  and isgraph_noalloc = foreign_ext ~noalloc:true "isgraph" t
+  and islower_noalloc = foreign_ext ~noalloc:true "islower" t
+  and isprint_noalloc = foreign_ext ~noalloc:true "isprint" t
+  and ispunct_noalloc = foreign_ext ~noalloc:true "ispunct" t
+  and isspace_noalloc = foreign_ext ~noalloc:true "isspace" t
+  and isupper_noalloc = foreign_ext ~noalloc:true "isupper" t
+  and isxdigit_noalloc = foreign_ext ~noalloc:true "isxdigit" t
+
+  (* Batched forms, which classify each character of an array. *)
+  let batch = Cstubs.(Batch_function (cchar, Batch_returns bool))
+
+  let isdigit_batch = foreign_batch "isdigit" batch
+  and isspace_batch = foreign_batch ~release_runtime_lock:true "isspace" batch
+  and isdigit_batch_unlocked =
+    foreign_batch ~release_runtime_lock:true "isdigit" batch
+
   (* char *strchr(const char *str, int c);  *)
   let strchr = foreign "strchr" (string @-> int @-> returning string)
 
@@ -45,6 +67,20 @@ struct
   let memset = foreign "memset"
     (ptr void @-> int @-> size_t @-> returning (ptr void))
 
+  (* Bindings that release the runtime lock during the call. *)
+  let strchr_unlocked = foreign_ext ~release_runtime_lock:true "strchr"
+    (string @-> int @-> returning string)
+
+  let memcmp_unlocked = foreign_ext ~release_runtime_lock:true "memcmp"
+    (ptr void @-> ptr void @-> size_t @-> returning int)
+
+  let memset_unlocked = foreign_ext ~release_runtime_lock:true "memset"
+    (ptr void @-> int @-> size_t @-> returning (ptr void))
+
+  (* unsigned int sleep(unsigned int seconds) *)
+  let sleep_unlocked = foreign_ext ~release_runtime_lock:true "sleep"
+    (uint @-> returning uint)
+
   (* let div = foreign "div" (int @-> int @-> returning div_t) *)
 
   let qsort = foreign "qsort"
@@ -11,7 +11,7 @@ open Unsigned
 open Foreign
 
 
-module Common_tests(S : Cstubs.FOREIGN with type 'a fn = 'a) =
+module Common_tests(S : Cstubs.FOREIGN_EXT with type 'a fn = 'a) =
 struct
   module M = Functions.Stubs(S)
   open M
@@ -68,6 +68,56 @@ struct
     end
 
 
+  (*
+    Call the noalloc bindings of the same functions, which should agree with
+    the default bindings.
+  *)
+  let test_noalloc_isX_functions () =
+    let check name f g =
+      String.iter (fun c ->
+        assert_equal ~msg:(Printf.sprintf "%s %C" name c) (f c) (g c))
+        "aZ09 \t\r\b;.?~fg"
+    in begin
+      check "isalnum" isalnum isalnum_noalloc;
+      check "isalpha" isalpha isalpha_noalloc;
+      check "iscntrl" iscntrl iscntrl_noalloc;
+      check "isdigit" isdigit isdigit_noalloc;
+      check "isgraph" isgraph isgraph_noalloc;
+      check "islower" islower islower_noalloc;
+      check "isprint" isprint isprint_noalloc;
+      check "ispunct" ispunct ispunct_noalloc;
+      check "isspace" isspace isspace_noalloc;
+      check "isupper" isupper isupper_noalloc;
+      check "isxdigit" isxdigit isxdigit_noalloc;
+
+      assert_bool "" (isalnum_noalloc 'a');
+      assert_bool "" (not (isalnum_noalloc ' '));
+    end
+
+
+  (*
+    Call the batched forms of isdigit and isspace, which classify each
+    character of an array.
+  *)
+  let test_batched_isX_functions () =
+    let chars = CArray.of_list cchar ['1'; 'a'; ' '; '9'] in
+    let results = CArray.make bool 4 in
+    begin
+      isdigit_batch chars results;
+      assert_equal [true; false; false; true] (CArray.to_list results);
+
+      isspace_batch chars results;
+      assert_equal [false; false; true; false] (CArray.to_list results);
+
+      isdigit_batch_unlocked chars results;
+      assert_equal [true; false; false; true] (CArray.to_list results);
+
+      assert_bool "arrays of different lengths"
+        (try isdigit_batch chars (CArray.make bool 3); false
+         with Invalid_argument _ -> true)
+    end
+
+
   (*
     Call the functions
 
@@ -311,6 +361,51 @@ module Foreign_tests = Common_tests(Tests_common.Foreign_binder)
 module Stub_tests = Common_tests(Generated_bindings)
 
 
+(*
+  Check that the bindings generated with ~release_runtime_lock:true let
+  another OCaml thread run while a blocking C call is in progress.
+*)
+let test_blocking_call_releases_lock () =
+  let open Stub_tests.M in
+  let counter = ref 0 and finished = ref false in
+  let worker = Thread.create (fun () ->
+    while not !finished do incr counter; Thread.yield () done) () in
+  begin
+    let before = !counter in
+    ignore (sleep_unlocked (Unsigned.UInt.of_int 1));
+    let after = !counter in
+    finished := true;
+    Thread.join worker;
+    assert_bool "another thread ran during the blocking call" (after > before)
+  end
+
+
+(*
+  Pass memory managed by OCaml to the bindings that release the runtime
+  lock while another thread runs the garbage collector.
+*)
+let test_managed_memory_without_lock () =
+  let open Stub_tests.M in
+  let finished = ref false in
+  let collector = Thread.create (fun () ->
+    while not !finished do Gc.full_major (); Thread.yield () done) () in
+  begin
+    for i = 1 to 100 do
+      let p = allocate_n uchar 64 and q = allocate_n uchar 64 in
+      let n = Size_t.of_int 64 in
+      ignore (memset_unlocked (to_voidp p) (i land 0xff) n);
+      ignore (memset_unlocked (to_voidp q) (i land 0xff) n);
+      assert_equal 0 (memcmp_unlocked (to_voidp p) (to_voidp q) n);
+      assert_equal (UChar.of_int (i land 0xff)) !@(p +@ 63);
+      let s = String.make i 'e' ^ "fg" in
+      assert_equal "fg" (strchr_unlocked s (Char.code 'f'))
+        ~printer:(fun x -> x);
+    done;
+    finished := true;
+    Thread.join collector
+  end
+
+
 let suite = "C standard library tests" >:::
   ["test isX functions (foreign)"
     >:: Foreign_tests.test_isX_functions;
@@ -318,12 +413,30 @@ let suite = "C standard library tests" >:::
    "test isX functions (stubs)"
     >:: Stub_tests.test_isX_functions;
 
+   "test noalloc isX functions (foreign)"
+    >:: Foreign_tests.test_noalloc_isX_functions;
+
+   "test noalloc isX functions (stubs)"
+    >:: Stub_tests.test_noalloc_isX_functions;
+
+   "test batched isX functions (foreign)"
+    >:: Foreign_tests.test_batched_isX_functions;
+
+   "test batched isX functions (stubs)"
+    >:: Stub_tests.test_batched_isX_functions;
+
    "test string function (foreign)"
     >:: Foreign_tests.test_string_functions;
 
    "test string function (stubs)"
     >:: Stub_tests.test_string_functions;
 
+   "test blocking call releases the runtime lock (stubs)"
+    >:: test_blocking_call_releases_lock;
+
+   "test managed memory without the runtime lock (stubs)"
+    >:: test_managed_memory_without_lock;
+
    "test div function"
     >:: test_div;
 
@@ -8,3 +8,4 @@
 (* Stub generation driver for the higher order tests. *)
 
 let () = Tests_common.run Sys.argv (module Functions.Stubs)
+  ~inverted:(module Functions.Exported)
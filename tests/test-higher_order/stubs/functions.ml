@@ -10,7 +10,7 @@
 open Ctypes
 open Foreign
 
-module Stubs (F: Cstubs.FOREIGN) =
+module Common (F: Cstubs.FOREIGN_EXT) =
 struct
   open F
   let higher_order_1 = foreign "higher_order_1"
@@ -29,3 +29,54 @@ struct
     (funptr (int @-> returning (funptr (int @-> returning int))) @->
      int @-> returning int)
 end
+
+(* OCaml functions exported to C. *)
+module Exported (I : Cstubs_inverted.INTERNAL) =
+struct
+  let () = I.internal "higher_order_add_exported"
+    (int @-> int @-> returning int) ( + )
+
+  let () = I.internal "higher_order_length_exported"
+    (string @-> returning int) String.length
+end
+
+(* Bindings to the exported functions, which are linked into the test
+   executable along with the stubs. *)
+module Stubs_only (F: Cstubs.FOREIGN) =
+struct
+  open F
+  let add_exported = foreign "higher_order_add_exported"
+    (int @-> int @-> returning int)
+
+  let length_exported = foreign "higher_order_length_exported"
+    (string @-> returning int)
+end
+
+(* A binding used to exhaust the trampolines for [int -> int] in the
+   generated stubs. *)
+module Funptr_pool (F: Cstubs.FOREIGN_EXT) =
+struct
+  open F
+  let higher_order_simplest = foreign "higher_order_simplest"
+    (funptr (int @-> returning int) @-> returning int)
+end
+
+(* A function pointer type with the same C type as [int -> int], but whose
+   result is converted by a view. *)
+module Funptr_views (F: Cstubs.FOREIGN_EXT) =
+struct
+  open F
+  let store_predicate = foreign "store_callback"
+    (funptr (int @-> returning bool) @-> returning void)
+
+  let invoke_stored_callback = foreign "invoke_stored_callback"
+    (int @-> returning int)
+end
+
+module Stubs (F: Cstubs.FOREIGN_EXT) =
+struct
+  include Common(F)
+  include Stubs_only(F)
+  include Funptr_pool(F)
+  include Funptr_views(F)
+end
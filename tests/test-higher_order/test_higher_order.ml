@@ -10,9 +10,9 @@ open OUnit
 open Foreign
 
 
-module Common_tests(S : Cstubs.FOREIGN with type 'a fn = 'a) =
+module Common_tests(S : Cstubs.FOREIGN_EXT with type 'a fn = 'a) =
 struct
-  module M = Functions.Stubs(S)
+  module M = Functions.Common(S)
   open M
 
   (*
@@ -96,6 +96,69 @@ module Foreign_tests = Common_tests(Tests_common.Foreign_binder)
 module Stub_tests = Common_tests(Generated_bindings)
 
 
+(*
+  Call OCaml functions exported to C through C functions generated by
+  Cstubs_inverted.
+*)
+let test_calling_exported_functions () =
+  let module M = Functions.Stubs_only(Generated_bindings) in
+  begin
+    Cstubs_inverted.register ~prefix:Tests_common.prefix
+      (module Functions.Exported);
+
+    assert_equal 15 (M.add_exported 10 5);
+    assert_equal 5 (M.length_exported "hello");
+  end
+
+
+(*
+  Pass more live OCaml functions of a single type to C than the generated
+  stubs have trampolines for that type, then check that the trampolines
+  are freed once the functions are unreachable.
+*)
+let test_funptr_pool_exhaustion () =
+  let module M = Functions.Funptr_pool(Generated_bindings) in
+  let live = ref [||] in
+  let fill n = live := Array.init n (fun i x -> x + i) in
+  let call_all () =
+    Array.iteri (fun i f ->
+      assert_equal (22 + i) (M.higher_order_simplest f)) !live in
+  let extra = (fun k x -> x * k) 2 in
+  begin
+    fill 32;
+    call_all ();
+
+    (* Passing the same functions again reuses their trampolines. *)
+    call_all ();
+
+    assert_bool "all trampolines in use"
+      (try ignore (M.higher_order_simplest extra); false
+       with Failure _ -> true);
+
+    live := [||];
+    assert_equal 44 (M.higher_order_simplest extra);
+  end
+
+
+(*
+  Pass OCaml functions of types with the same C type but different OCaml
+  representations to C through the generated stubs.
+*)
+let test_funptr_views () =
+  let module P = Functions.Funptr_pool(Generated_bindings) in
+  let module V = Functions.Funptr_views(Generated_bindings) in
+  let is_even x = x mod 2 = 0 in
+  begin
+    assert_equal 23 (P.higher_order_simplest succ);
+
+    V.store_predicate is_even;
+    assert_equal 1 (V.invoke_stored_callback 4);
+    assert_equal 0 (V.invoke_stored_callback 5);
+
+    assert_equal 21 (P.higher_order_simplest pred);
+  end
+
+
 let suite = "Higher-order tests" >:::
   ["test_higher_order_basic (foreign)"
    >:: Foreign_tests.test_higher_order_basic;
@@ -120,6 +183,15 @@ let suite = "Higher-order tests" >:::
 
    "test_callback_returns_pointer_to_function (stubs)"
    >:: Stub_tests.test_callback_returns_pointer_to_function;
+
+   "test calling exported functions"
+   >:: test_calling_exported_functions;
+
+   "test funptr pool exhaustion (stubs)"
+   >:: test_funptr_pool_exhaustion;
+
+   "test function pointers with views (stubs)"
+   >:: test_funptr_views;
   ]
 
 
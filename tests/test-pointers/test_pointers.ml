@@ -535,6 +535,43 @@ let test_raw_pointers () =
   assert_equal praw' Int64.(add praw (of_int (3 * sizeof double)))
 
 
+(*
+  Test reading and writing long, long long and size_t values as OCaml ints.
+*)
+let test_integers_as_ints () =
+  let p = allocate long (Signed.Long.of_int (-17)) in
+  let pi = from_voidp long_as_int (to_voidp p) in
+  begin
+    assert_equal (-17) !@pi;
+    pi <-@ max_int;
+    assert_equal (Signed.Long.of_int max_int) !@p;
+  end;
+
+  let q = allocate llong (Signed.LLong.of_int 3) in
+  let qi = from_voidp llong_as_int (to_voidp q) in
+  begin
+    assert_equal 3 !@qi;
+    q <-@ Signed.LLong.max_int;
+    assert_raises (Failure "ctypes_copy_llong_as_int") (fun () -> !@qi);
+  end;
+
+  let r = allocate size_t (Unsigned.Size_t.of_int 10) in
+  let ri = from_voidp size_t_as_int (to_voidp r) in
+  begin
+    assert_equal 10 !@ri;
+    ri <-@ 20;
+    assert_equal (Unsigned.Size_t.of_int 20) !@r;
+    assert_raises (Invalid_argument "ctypes_size_t_as_int_val")
+      (fun () -> ri <-@ (-1));
+    r <-@ Unsigned.Size_t.max_int;
+    assert_raises (Failure "ctypes_copy_size_t_as_int") (fun () -> !@ri);
+  end;
+
+  assert_equal (sizeof long) (sizeof long_as_int);
+  assert_equal (sizeof llong) (sizeof llong_as_int);
+  assert_equal (sizeof size_t) (sizeof size_t_as_int)
+
+
 module Foreign_tests = Common_tests(Tests_common.Foreign_binder)
 module Stub_tests = Common_tests(Generated_bindings)
 
@@ -619,6 +656,9 @@ let suite = "Pointer tests" >:::
 
    "raw"
     >:: test_raw_pointers;
+
+   "integers as OCaml ints"
+    >:: test_integers_as_ints;
   ]
 
 
@@ -235,6 +235,36 @@ let test_sizeof_views () = begin
 end
 
 
+(*
+  Test that the sizes of arrays and views of incomplete types are computed
+  once the underlying type is complete.
+*)
+let test_sizeof_completed () =
+  let module M = struct
+    type s
+    let s : s structure typ = structure "s"
+    let arr = array 3 (array 2 s)
+    let v = view ~read:(fun x -> x) ~write:(fun x -> x) s
+
+    let () = begin
+      assert_raises IncompleteType (fun () -> sizeof arr);
+      assert_raises IncompleteType (fun () -> alignment v);
+    end
+
+    let _ = field s "x" int32_t
+    let _ = field s "y" int16_t
+    let () = seal s
+
+    let () = begin
+      assert_equal (6 * sizeof s) (sizeof arr);
+      assert_equal (6 * sizeof s) (sizeof arr);
+      assert_equal (alignment s) (alignment arr);
+      assert_equal (sizeof s) (sizeof v);
+      assert_equal (alignment s) (alignment v);
+    end
+  end in ()
+
+
 let suite = "sizeof tests" >:::
   ["sizeof primitives"
    >:: test_sizeof_primitives;
@@ -265,6 +295,9 @@ let suite = "sizeof tests" >:::
 
    "sizeof views"
    >:: test_sizeof_views;
+
+   "sizeof types completed after construction"
+   >:: test_sizeof_completed;
   ]
 
 
@@ -8,4 +8,5 @@
 (* Stub generation driver for the struct tests. *)
 
 let () = Tests_common.run Sys.argv (module Functions.Stubs)
+    ~structs:(module Functions.Types)
 
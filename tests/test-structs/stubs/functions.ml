@@ -59,8 +59,49 @@ struct
 end
 
 
-module Stubs (F: Cstubs.FOREIGN) =
+module Stubs (F: Cstubs.FOREIGN_EXT) =
 struct
   include Common(F)
   include Stubs_only(F)
+
+  (* add_triples, storing the result in a struct supplied by the caller. *)
+  let add_triples_into = F.foreign_into "add_triples"
+    Cstubs.(Into_function (triple, Into_function (triple, Into_returns triple)))
+end
+
+
+(* Types whose layouts, and constants whose values, are retrieved from C
+   using Cstubs_structs. *)
+module Types (T : Cstubs_structs.TYPE) =
+struct
+  open T
+
+  type simple
+  let simple : simple structure typ = structure "simple"
+  let i = field simple "i" int
+  let f = field simple "f" double
+  let self = field simple "self" (ptr simple)
+  let () = seal simple
+
+  type number
+  let number : number union typ = union "number"
+  let ni = field number "i" int
+  let nd = field number "d" double
+  let () = seal number
+
+  type tagged
+  let tagged : tagged structure typ = structure "tagged"
+  let tag = field tagged "tag" char
+  let num = field tagged "num" number
+  let () = seal tagged
+
+  let negative = constant "TEST_NEGATIVE_CONSTANT" int
+
+  type fruit = Orange | Apple | Banana | Pear
+  let fruit = enum "fruit" [
+    Orange, constant "Orange" int64_t;
+    Apple, constant "Apple" int64_t;
+    Banana, constant "Banana" int64_t;
+    Pear, constant "Pear" int64_t;
+  ]
 end
@@ -342,7 +342,7 @@ let test_struct_ffi_type_lifetime () =
   end in ()
 
 
-module Build_stub_tests(S : Cstubs.FOREIGN with type 'a fn = 'a) =
+module Build_stub_tests(S : Cstubs.FOREIGN_EXT with type 'a fn = 'a) =
 struct
   open Functions
   include Build_foreign_tests(S)
@@ -375,19 +375,21 @@ struct
     end
 
 
+  let mkTriple (x, y, z) =
+    let t = make triple in
+    t @. elements <-@ CArray.of_list double [x; y; z];
+    t
+
+  let readTriple t =
+    match CArray.to_list (getf t elements) with
+    | [x; y; z] -> (x, y, z)
+    | _ -> assert false
+
+
   (*
     Test passing structs with array members.
   *)
   let test_passing_structs_with_array_members () =
-    let mkTriple (x, y, z) =
-      let t = make triple in
-      t @. elements <-@ CArray.of_list double [x; y; z];
-      t
-    and readTriple t =
-      match CArray.to_list (getf t elements) with
-      | [x; y; z] -> (x, y, z)
-      | _ -> assert false
-    in
     begin
       assert_equal
         (10.0, 20.0, 30.0)
@@ -396,8 +398,463 @@ struct
               (mkTriple (5.0, 12.0, 17.0))
               (mkTriple (5.0,  8.0, 13.0))))
     end
+
+
+  (*
+    Test storing a struct result in memory supplied by the caller, reusing
+    the same struct for successive calls.
+  *)
+  let test_returning_structs_into_memory () =
+    let r = make triple in
+    begin
+      add_triples_into
+        (mkTriple (1.0, 2.0, 3.0)) (mkTriple (4.0, 5.0, 6.0)) (addr r);
+      assert_equal (5.0, 7.0, 9.0) (readTriple r);
+
+      add_triples_into r r (addr r);
+      assert_equal (10.0, 14.0, 18.0) (readTriple r);
+    end
 end
 
+(*
+  Test reading and writing bitfields.  The layout should match the layout
+  chosen by the C compiler for the following struct:
+
+     struct bitfields {
+       uint8_t a : 3;
+       uint8_t b : 2;
+       int c : 7;
+       int d : 30;
+       char e;
+       int16_t f : 9;
+     };
+*)
+let test_bitfields () =
+  let module M = struct
+    type bitfields
+    let bitfields : bitfields structure typ = structure "bitfields"
+    let a = bitfield bitfields "a" ~width:3 uint8_t
+    let b = bitfield bitfields "b" ~width:2 uint8_t
+    let c = bitfield bitfields "c" ~width:7 int
+    let d = bitfield bitfields "d" ~width:30 int
+    let e = field bitfields "e" char
+    let f = bitfield bitfields "f" ~width:9 int16_t
+    let () = seal bitfields
+
+    let () = begin
+      assert_equal 12 (sizeof bitfields);
+      assert_equal 4 (alignment bitfields);
+      assert_equal 8 (offsetof e);
+    end
+
+    let u8 = Unsigned.UInt8.of_int
+    let s = make bitfields
+
+    let () = begin
+      setf s e 'x';
+      setbf s a (u8 5);
+      setbf s b (u8 3);
+      setbf s c (-3);
+      setbf s d (-123456);
+      setbf s f (-200);
+
+      assert_equal (u8 5) (getbf s a);
+      assert_equal (u8 3) (getbf s b);
+      assert_equal (-3) (getbf s c);
+      assert_equal (-123456) (getbf s d);
+      assert_equal 'x' (getf s e);
+      assert_equal (-200) (getbf s f);
+
+      if not Sys.big_endian then
+        assert_equal 0xbd (Char.code !@(from_voidp char (to_voidp (addr s))));
+
+      (* Values are truncated to the width of the bitfield, and neighbouring
+         bitfields are left unchanged. *)
+      setbf s b (u8 6);
+      assert_equal (u8 2) (getbf s b);
+      assert_equal (u8 5) (getbf s a);
+      assert_equal (-3) (getbf s c);
+    end
+  end in ()
+
+
+(*
+  Test that zero-width bitfields pad to the next storage unit without
+  affecting the alignment, and that invalid bitfields are rejected.
+
+     struct padded { char x; int : 0; char y; };
+*)
+let test_bitfield_padding () =
+  let module M = struct
+    type padded
+    let padded : padded structure typ = structure "padded"
+    let x = field padded "x" char
+    let _ = bitfield padded "" ~width:0 int
+    let y = field padded "y" char
+    let () = seal padded
+
+    let () = begin
+      assert_equal 5 (sizeof padded);
+      assert_equal 1 (alignment padded);
+      assert_equal 4 (offsetof y);
+    end
+
+    let () = begin
+      assert_raises (Invalid_argument "Ctypes.bitfield")
+        (fun () -> bitfield padded "z" ~width:9 uint8_t);
+
+      assert_raises (Unsupported "bitfield of non-integer type")
+        (fun () -> bitfield padded "z" ~width:3 double);
+    end
+  end in ()
+
+
+(*
+  Test the layout of packed structs and structs with aligned members.  The
+  layouts should match the layouts chosen by the C compiler for the
+  following structs:
+
+     #pragma pack(2)
+     struct pack2 { char a; int b; char c; double d; };
+     #pragma pack()
+
+     struct packed { char a; int b; char c; } __attribute__((packed));
+
+     struct packed_aligned {
+       char a; int b __attribute__((aligned(4))); char c;
+     } __attribute__((packed));
+
+     struct overaligned { char a; int b __attribute__((aligned(16))); char c; };
+
+     struct packed_padded { char a; int : 0; char b; } __attribute__((packed));
+
+     #pragma pack(2)
+     struct pack2_padded { char a; int : 0; char b; };
+     #pragma pack()
+*)
+let test_packed_struct_layout () =
+  let module M = struct
+    type pack2
+    let pack2 : pack2 structure typ = structure ~pack:2 "pack2"
+    let _ = field pack2 "a" char
+    let b = field pack2 "b" int
+    let c = field pack2 "c" char
+    let d = field pack2 "d" double
+    let () = seal pack2
+
+    let () = begin
+      assert_equal 16 (sizeof pack2);
+      assert_equal 2 (alignment pack2);
+      assert_equal 2 (offsetof b);
+      assert_equal 6 (offsetof c);
+      assert_equal 8 (offsetof d);
+    end
+
+    type packed
+    let packed : packed structure typ = structure ~packed:true "packed"
+    let _ = field packed "a" char
+    let b = field packed "b" int
+    let c = field packed "c" char
+    let () = seal packed
+
+    let () = begin
+      assert_equal 6 (sizeof packed);
+      assert_equal 1 (alignment packed);
+      assert_equal 1 (offsetof b);
+      assert_equal 5 (offsetof c);
+    end
+
+    type packed_aligned
+    let packed_aligned : packed_aligned structure typ =
+      structure ~packed:true "packed_aligned"
+    let _ = field packed_aligned "a" char
+    let b = field ~align:4 packed_aligned "b" int
+    let _ = field packed_aligned "c" char
+    let () = seal packed_aligned
+
+    let () = begin
+      assert_equal 12 (sizeof packed_aligned);
+      assert_equal 4 (alignment packed_aligned);
+      assert_equal 4 (offsetof b);
+    end
+
+    type overaligned
+    let overaligned : overaligned structure typ = structure "overaligned"
+    let _ = field overaligned "a" char
+    let b = field ~align:16 overaligned "b" int
+    let _ = field overaligned "c" char
+    let () = seal overaligned
+
+    let () = begin
+      assert_equal 32 (sizeof overaligned);
+      assert_equal 16 (alignment overaligned);
+      assert_equal 16 (offsetof b);
+    end
+
+    (* Zero-width bitfields pad to the natural alignment of their type
+       whatever the packing. *)
+    type packed_padded
+    let packed_padded : packed_padded structure typ =
+      structure ~packed:true "packed_padded"
+    let _ = field packed_padded "a" char
+    let _ = bitfield packed_padded "" ~width:0 int
+    let b = field packed_padded "b" char
+    let () = seal packed_padded
+
+    let () = begin
+      assert_equal 5 (sizeof packed_padded);
+      assert_equal 1 (alignment packed_padded);
+      assert_equal 4 (offsetof b);
+    end
+
+    type pack2_padded
+    let pack2_padded : pack2_padded structure typ =
+      structure ~pack:2 "pack2_padded"
+    let _ = field pack2_padded "a" char
+    let _ = bitfield pack2_padded "" ~width:0 int
+    let b = field pack2_padded "b" char
+    let () = seal pack2_padded
+
+    let () = begin
+      assert_equal 5 (sizeof pack2_padded);
+      assert_equal 1 (alignment pack2_padded);
+      assert_equal 4 (offsetof b);
+    end
+
+    let () = begin
+      assert_raises (Invalid_argument "Ctypes.structure")
+        (fun () -> structure ~pack:3 "bad");
+
+      assert_raises (Invalid_argument "Ctypes.field")
+        (fun () -> field ~align:6 (structure "bad") "x" int);
+    end
+  end in ()
+
+
+(*
+  Test reading and writing unaligned members of packed structs, including
+  bitfields that straddle byte boundaries:
+
+     struct packed_record {
+       uint8_t tag : 3;
+       uint8_t flags : 4;
+       uint16_t len : 5;
+       double value;
+       int32_t id;
+     } __attribute__((packed));
+*)
+let test_packed_struct_access () =
+  let module M = struct
+    type packed_record
+    let packed_record : packed_record structure typ =
+      structure ~packed:true "packed_record"
+    let tag = bitfield packed_record "tag" ~width:3 uint8_t
+    let flags = bitfield packed_record "flags" ~width:4 uint8_t
+    let len = bitfield packed_record "len" ~width:5 uint16_t
+    let value = field packed_record "value" double
+    let id = field packed_record "id" int32_t
+    let () = seal packed_record
+
+    let () = begin
+      assert_equal 14 (sizeof packed_record);
+      assert_equal 2 (offsetof value);
+      assert_equal 10 (offsetof id);
+    end
+
+    let records = CArray.make packed_record 3
+
+    let () =
+      for i = 0 to 2 do
+        let r = CArray.get records i in
+        setbf r tag (Unsigned.UInt8.of_int i);
+        setbf r flags (Unsigned.UInt8.of_int (15 - i));
+        setbf r len (Unsigned.UInt16.of_int (20 + i));
+        setf r value (float_of_int i +. 0.5);
+        setf r id (Int32.of_int (-i));
+      done
+
+    let () =
+      for i = 0 to 2 do
+        let r = CArray.get records i in
+        assert_equal (Unsigned.UInt8.of_int i) (getbf r tag);
+        assert_equal (Unsigned.UInt8.of_int (15 - i)) (getbf r flags);
+        assert_equal (Unsigned.UInt16.of_int (20 + i)) (getbf r len);
+        assert_equal (float_of_int i +. 0.5) (getf r value);
+        assert_equal (Int32.of_int (-i)) (getf r id);
+      done
+  end in ()
+
+
+(*
+  Test converting between arrays of OCaml records and arrays of C structs.
+*)
+type sample = { time : int; value : float; valid : bool }
+
+let test_record_codec () =
+  let module M = struct
+    type csample
+    let csample : csample structure typ = structure "sample"
+    let time = field csample "time" int64_t
+    let value = field csample "value" double
+    let valid = field csample "valid"
+        (view ~read:(fun c -> c <> 0) ~write:(fun b -> if b then 1 else 0) int)
+    let () = seal csample
+
+    let c = Codec.create csample
+        ~make:(fun time value valid -> { time = Int64.to_int time; value; valid })
+        Codec.(Member (time, (fun s -> Int64.of_int s.time),
+               Member (value, (fun s -> s.value),
+               Member (valid, (fun s -> s.valid),
+               Done))))
+
+    let samples = Array.init 10
+        (fun i -> { time = i * 100; value = float_of_int i /. 4.0;
+                    valid = i mod 3 = 0 })
+
+    let () = begin
+      let encoded = Codec.encode c samples in
+      assert_equal 10 (CArray.length encoded);
+      for i = 0 to 9 do
+        let s = CArray.get encoded i in
+        assert_equal (Int64.of_int (i * 100)) (getf s time);
+        assert_equal (float_of_int i /. 4.0) (getf s value);
+        assert_equal (i mod 3 = 0) (getf s valid);
+      done;
+      assert_equal samples (Codec.decode c encoded);
+      assert_equal (Array.to_list samples)
+        (Codec.decode_list c (Codec.encode_list c (Array.to_list samples)));
+    end
+  end in ()
+
+
+(*
+  Test the layout analysis of the following struct:
+
+     struct loose { char a; int32_t b; char c; int16_t d; };
+*)
+let test_layout_analysis () =
+  let module M = struct
+    type loose
+    let loose : loose structure typ = structure "loose"
+    let _ = field loose "a" char
+    let _ = field loose "b" int32_t
+    let _ = field loose "c" char
+    let _ = field loose "d" int16_t
+    let () = seal loose
+
+    let r = Layout.analyse loose ~cache_line:6
+
+    let () = Layout.(begin
+      assert_equal 12 r.size;
+      assert_equal 4 r.align;
+      assert_equal [0; 4; 8; 10] (List.map (fun m -> m.offset) r.members);
+      assert_equal
+        [{ hole_offset = 1; hole_size = 3 }; { hole_offset = 9; hole_size = 1 }]
+        r.holes;
+      assert_equal 4 r.wasted;
+      assert_equal ["b"] (List.map (fun m -> m.name) r.straddling);
+      assert_equal ["b"; "d"; "a"; "c"] r.suggested_order;
+      assert_equal 8 r.suggested_size;
+    end)
+
+    let () = assert_raises IncompleteType
+        (fun () -> Layout.analyse (structure "incomplete"))
+  end in ()
+
+
+(*
+  Test structs with flexible array members:
+
+     struct msg { int32_t len; char c; int16_t data[]; };
+*)
+let test_flexible_array_members () =
+  let module M = struct
+    type msg
+    let msg : msg structure typ = structure "msg"
+    let len = field msg "len" int32_t
+    let c = field msg "c" char
+    let data = flexible_array msg "data" int16_t
+    let () = begin
+      assert_raises (Unsupported "field after a flexible array member")
+        (fun () -> field msg "extra" int);
+      assert_raises (Unsupported "field after a flexible array member")
+        (fun () -> flexible_array msg "more" int);
+    end
+    let () = seal msg
+
+    let () = begin
+      assert_equal 8 (sizeof msg);
+      assert_equal 4 (alignment msg);
+      assert_raises (ModifyingSealedType "msg")
+        (fun () -> field msg "extra" int);
+    end
+
+    let m = make_flexible msg data ~count:10
+    let () = begin
+      setf m len 10l;
+      setf m c 'x';
+      let arr = getflex m data ~length:10 in
+      for i = 0 to 9 do CArray.set arr i (i * 100) done;
+      assert_equal 10 (CArray.length arr);
+      assert_equal ~msg:"the trailing elements start at offset 6" 6
+        (ptr_diff (from_voidp char (to_voidp (addr m)))
+           (from_voidp char (to_voidp (CArray.start arr))));
+      assert_equal 900 (CArray.get (getflex m data ~length:10) 9);
+      assert_equal 10l (getf m len);
+      assert_equal 'x' (getf m c);
+    end
+
+    type empty
+    let empty : empty structure typ = structure "empty"
+    let () = assert_raises
+        (Unsupported "flexible array member in a struct with no other fields")
+        (fun () -> flexible_array empty "data" int)
+  end in ()
+
+
+(*
+  Check that struct and union layouts, constants and enums retrieved from C
+  using Cstubs_structs agree with the C declarations.
+*)
+let test_retrieved_layouts () =
+  let module T = Functions.Types(Generated_struct_bindings) in
+  let module C = struct
+    type simple
+    let simple : simple structure typ = structure "simple"
+    let i = field simple "i" int
+    let f = field simple "f" double
+    let self = field simple "self" (ptr simple)
+    let () = seal simple
+  end in
+  begin
+    assert_equal (sizeof C.simple) (sizeof T.simple);
+    assert_equal (alignment C.simple) (alignment T.simple);
+    assert_equal (offsetof C.i) (offsetof T.i);
+    assert_equal (offsetof C.f) (offsetof T.f);
+    assert_equal (offsetof C.self) (offsetof T.self);
+
+    assert_equal (alignment T.number) (offsetof T.num);
+    assert_equal (offsetof T.num + sizeof T.number) (sizeof T.tagged);
+
+    let t = make T.tagged and n = make T.number in
+    setf n T.nd 2.5;
+    setf t T.tag 'a';
+    setf t T.num n;
+    assert_equal 'a' (getf t T.tag);
+    assert_equal 2.5 (getf (getf t T.num) T.nd);
+
+    assert_equal (-37) T.negative;
+
+    let p = allocate T.fruit T.Banana in
+    assert_equal T.Banana !@p;
+    assert_equal (sizeof int) (sizeof T.fruit);
+    assert_equal 2 (!@(from_voidp int (to_voidp p)));
+    from_voidp int (to_voidp p) <-@ 10;
+    assert_raises (Failure "Unexpected value 10 for enum fruit")
+      (fun () -> !@p);
+  end
+
+
 module Foreign_tests = Build_foreign_tests(Tests_common.Foreign_binder)
 module Stub_tests = Build_stub_tests(Generated_bindings)
 
@@ -430,6 +887,9 @@ let suite = "Struct tests" >:::
    "passing structs with array members (stubs)"
    >:: Stub_tests.test_passing_structs_with_array_members;
 
+   "returning structs into memory (stubs)"
+   >:: Stub_tests.test_returning_structs_into_memory;
+
    "structs with array members"
    >:: test_structs_with_array_members;
 
@@ -444,6 +904,30 @@ let suite = "Struct tests" >:::
 
    "test struct ffi_type lifetime"
    >:: test_struct_ffi_type_lifetime;
+
+   "bitfields"
+   >:: test_bitfields;
+
+   "bitfield padding"
+   >:: test_bitfield_padding;
+
+   "packed struct layout"
+   >:: test_packed_struct_layout;
+
+   "packed struct access"
+   >:: test_packed_struct_access;
+
+   "record codec"
+   >:: test_record_codec;
+
+   "layout analysis"
+   >:: test_layout_analysis;
+
+   "flexible array members"
+   >:: test_flexible_array_members;
+
+   "struct layouts and constants retrieved from C"
+   >:: test_retrieved_layouts;
   ]
 
 
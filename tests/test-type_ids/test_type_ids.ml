@@ -0,0 +1,167 @@
+(*
+ * Copyright (c) 2014 Jeremy Yallop.
+ *
+ * This file is distributed under the terms of the MIT License.
+ * See the file LICENSE for details.
+ *)
+
+open OUnit
+open Ctypes
+
+
+let same_id l r = Type_id.(equal (of_typ l) (of_typ r))
+let same_fn_id l r = Type_id.(equal (of_fn l) (of_fn r))
+let fingerprint t = Type_id.(fingerprint (of_typ t))
+let representation fn = Type_id.(representation (of_fn fn))
+
+
+(*
+  Test that types built in the same way have the same descriptors, and
+  that types built differently have different descriptors.
+*)
+let test_type_identity () = begin
+  assert_bool "int" (same_id int int);
+  assert_bool "int* int*" (same_id (ptr int) (ptr int));
+  assert_bool "int[3][4]" (same_id (array 3 (array 4 int))
+                             (array 3 (array 4 int)));
+  assert_bool "int8_t and uint8_t" (not (same_id int8_t uint8_t));
+  assert_bool "int[3] and int[4]" (not (same_id (array 3 int) (array 4 int)));
+  assert_bool "int* and int**" (not (same_id (ptr int) (ptr (ptr int))));
+
+  assert_bool "functions"
+    (same_fn_id (int @-> ptr char @-> returning void)
+                (int @-> ptr char @-> returning void));
+  assert_bool "functions with different return types"
+    (not (same_fn_id (int @-> returning void) (int @-> returning int)));
+
+  assert_raises IncompleteType
+    (fun () -> Type_id.of_typ (structure "incomplete"));
+end
+
+
+(*
+  Test the identity of struct types, including recursive struct types.
+*)
+let test_struct_identity () =
+  let module M = struct
+    type node
+    let make_node () =
+      let node : node structure typ = structure "node" in
+      let _ = field node "value" int in
+      let _ = field node "next" (ptr node) in
+      seal node;
+      node
+
+    let n1 = make_node () and n2 = make_node ()
+    let () = assert_bool "structurally identical structs"
+        (same_id n1 n2)
+
+    let other : node structure typ = structure "node"
+    let _ = field other "value" double
+    let () = seal other
+    let () = assert_bool "structs with different layouts"
+        (not (same_id n1 other))
+
+    let () = assert_bool "pointers to structs with the same tag"
+        (same_id (ptr n1) (ptr other))
+
+    let () = assert_bool "pointer to incomplete struct"
+        (same_id (ptr (structure "node")) (ptr n1))
+  end in ()
+
+
+(*
+  Test that views are identified by identity, but have the fingerprint of
+  the underlying type.
+*)
+let test_view_identity () =
+  let v1 = view ~read:(fun x -> x) ~write:(fun x -> x) int
+  and v2 = view ~read:(fun x -> x) ~write:(fun x -> x) int in
+  begin
+    assert_bool "a view is equal to itself" (same_id v1 v1);
+    assert_bool "distinct views" (not (same_id v1 v2));
+    assert_bool "arrays of distinct views"
+      (not (same_id (array 2 v1) (array 2 v2)));
+    assert_equal (fingerprint int) (fingerprint v1);
+    assert_equal (fingerprint int) (fingerprint v2);
+  end
+
+
+(*
+  Test that descriptors are preserved across collections while they are
+  reachable, and that the cached descriptors of arrays and views can be
+  recomputed after they have been collected.
+*)
+let test_collected_descriptors () =
+  let v = view ~read:(fun x -> x) ~write:(fun x -> x) int in
+  let a = array 3 v in
+  let kept = Type_id.of_typ (array 4 int) in
+  begin
+    ignore (Type_id.of_typ a);
+    Gc.full_major ();
+    assert_bool "a kept descriptor is preserved"
+      (Type_id.equal kept (Type_id.of_typ (array 4 int)));
+    assert_bool "an array of a view after a collection" (same_id a a);
+    assert_bool "separately built arrays of the same view"
+      (same_id a (array 3 v));
+    assert_equal (fingerprint (array 3 int)) (fingerprint a);
+  end
+
+
+(*
+  Test that fingerprints do not vary between runs.
+*)
+let test_fingerprint_stability () = begin
+  assert_equal ~printer:Int64.to_string
+    0x2ba54303958efbf3L (fingerprint void);
+  assert_bool "fingerprints of distinct types"
+    (fingerprint int <> fingerprint uint);
+end
+
+
+(*
+  Test that function types with the same C type but different OCaml
+  representations have different representation hashes.
+*)
+let test_representation () =
+  let v1 = view ~read:(fun x -> x) ~write:(fun x -> x) int
+  and v2 = view ~read:(fun x -> x) ~write:(fun x -> x) int in
+  begin
+    assert_equal
+      (Type_id.(fingerprint (of_fn (int @-> returning int))))
+      (Type_id.(fingerprint (of_fn (int @-> returning bool))));
+    assert_bool "int and bool results"
+      (representation (int @-> returning int) <>
+       representation (int @-> returning bool));
+    assert_bool "long and long_as_int arguments"
+      (representation (long @-> returning void) <>
+       representation (long_as_int @-> returning void));
+    assert_equal
+      (representation (v1 @-> returning void))
+      (representation (v2 @-> returning void));
+  end
+
+
+let suite = "Type identity tests" >:::
+  ["type identity"
+    >:: test_type_identity;
+
+   "struct identity"
+    >:: test_struct_identity;
+
+   "view identity"
+    >:: test_view_identity;
+
+   "collected descriptors"
+    >:: test_collected_descriptors;
+
+   "fingerprint stability"
+    >:: test_fingerprint_stability;
+
+   "representation"
+    >:: test_representation;
+  ]
+
+
+let _ =
+  run_test_tt_main suite
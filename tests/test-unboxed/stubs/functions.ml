@@ -0,0 +1,26 @@
+(*
+ * Copyright (c) 2014 Jeremy Yallop.
+ *
+ * This file is distributed under the terms of the MIT License.
+ * See the file LICENSE for details.
+ *)
+
+(* Foreign function bindings for the unboxed stub tests. *)
+
+open Ctypes
+
+module Stubs (F: Cstubs.FOREIGN_EXT) =
+struct
+  open F
+
+  let halve_double = foreign "halve_double" (double @-> returning double)
+
+  let add_int64_int = foreign "add_int64_int"
+    (int64_t @-> int @-> returning int64_t)
+
+  let sum_six_ints = foreign "sum_six_ints"
+    (int @-> int @-> int @-> int @-> int @-> int @-> returning int)
+
+  let sum_six_ints_noalloc = foreign_ext ~noalloc:true "sum_six_ints"
+    (int @-> int @-> int @-> int @-> int @-> int @-> returning int)
+end
@@ -0,0 +1,136 @@
+(*
+ * Copyright (c) 2014 Jeremy Yallop.
+ *
+ * This file is distributed under the terms of the MIT License.
+ * See the file LICENSE for details.
+ *)
+
+open OUnit
+
+module Bindings = Functions.Stubs(Generated_bindings)
+
+
+(*
+  Call functions whose arguments and results the native stubs receive and
+  return without boxing:
+
+     double halve_double(double)
+     int64_t add_int64_int(int64_t, int)
+     int sum_six_ints(int, int, int, int, int, int)
+*)
+let test_unboxed_calls () =
+  let open Bindings in
+  begin
+    assert_equal 2.5 (halve_double 5.0) ~printer:string_of_float;
+    assert_equal (-0.25) (halve_double (-0.5)) ~printer:string_of_float;
+
+    assert_equal (Int64.pred Int64.max_int)
+      (add_int64_int Int64.max_int (-1)) ~printer:Int64.to_string;
+    assert_equal (-1L) (add_int64_int 1L (-2)) ~printer:Int64.to_string;
+    assert_equal 0x100000000L (add_int64_int 0xffffffffL 1)
+      ~printer:Int64.to_string;
+
+    assert_equal 21 (sum_six_ints 1 2 3 4 5 6) ~printer:string_of_int;
+    assert_equal 21 (sum_six_ints_noalloc 1 2 3 4 5 6)
+      ~printer:string_of_int;
+    assert_equal (-3) (sum_six_ints (-1) (-2) 0 0 0 0) ~printer:string_of_int;
+  end
+
+
+(* The text of the external declaration whose stubs are named [stub] in
+   the generated ML. *)
+let external_decl ml stub =
+  let name = Str.search_forward
+      (Str.regexp ("\"" ^ stub ^ "\\(_unboxed\\|_byte[0-9]+\\)?\"")) ml 0 in
+  let start = Str.search_backward (Str.regexp_string "external") ml name in
+  let stop =
+    try Str.search_forward (Str.regexp "external\\|type 'a fn") ml (start + 1)
+    with Not_found -> String.length ml in
+  String.sub ml start (stop - start)
+
+(* The [@unboxed] and [@untagged] attributes were introduced in 4.03. *)
+let unboxed_attributes =
+  Scanf.sscanf Sys.ocaml_version "%d.%d"
+    (fun major minor -> (major, minor) >= (4, 3))
+
+let matches s re =
+  try ignore (Str.search_forward re s 0); true
+  with Not_found -> false
+
+let contains s sub = matches s (Str.regexp_string sub)
+
+
+(*
+  Check that the generated externals carry the unboxing attributes and name
+  both the bytecode stub and the native stub.  Compilers before 4.03 support
+  only the "float" attribute, for functions that take and return only
+  floats, and the old-style "noalloc", which must follow the first name.
+*)
+let test_generated_externals () =
+  let ml =
+    let b = Buffer.create 1024 in
+    let fmt = Format.formatter_of_buffer b in
+    Cstubs.write_ml fmt ~prefix:"unboxed_" (module Functions.Stubs);
+    Format.pp_print_flush fmt ();
+    Buffer.contents b in
+  let halve = external_decl ml "unboxed_halve_double"
+  and add = external_decl ml "unboxed_add_int64_int"
+  and sum = external_decl ml "unboxed_sum_six_ints"
+  and sum_noalloc = external_decl ml "unboxed_sum_six_ints_noalloc" in
+  let check decl sub =
+    assert_bool (Printf.sprintf "%S in %S" sub decl) (contains decl sub) in
+  let check_not decl sub =
+    assert_bool (Printf.sprintf "%S not in %S" sub decl)
+      (not (contains decl sub)) in
+  begin
+    check halve "\"unboxed_halve_double\"";
+    check halve "\"unboxed_halve_double_unboxed\"";
+    check sum "\"unboxed_sum_six_ints_byte6\"";
+    check_not sum "noalloc";
+    check sum_noalloc "\"unboxed_sum_six_ints_noalloc_byte6\"";
+
+    if unboxed_attributes then begin
+      check halve "[@unboxed]";
+      check_not halve "\"float\"";
+
+      check add "[@unboxed]";
+      check add "[@untagged]";
+      check add "\"unboxed_add_int64_int\"";
+      check add "\"unboxed_add_int64_int_unboxed\"";
+
+      check sum "[@untagged]";
+      check sum "\"unboxed_sum_six_ints_unboxed\"";
+
+      check sum_noalloc "[@untagged]";
+      check sum_noalloc "[@@noalloc]";
+      check_not sum_noalloc "\"noalloc\"";
+    end
+    else begin
+      check halve "\"float\"";
+
+      check_not add "[@";
+      check_not add "_unboxed\"";
+
+      check_not sum "[@";
+      check sum "\"unboxed_sum_six_ints\"";
+
+      check_not sum_noalloc "[@";
+      assert_bool "\"noalloc\" follows the bytecode name"
+        (matches sum_noalloc
+           (Str.regexp ("\"unboxed_sum_six_ints_noalloc_byte6\"[ \n]+" ^
+                        "\"noalloc\"[ \n]+\"unboxed_sum_six_ints_noalloc\"")));
+    end
+  end
+
+
+let suite = "Unboxed stub tests" >:::
+  ["calling functions through unboxed stubs"
+    >:: test_unboxed_calls;
+
+   "unboxing attributes on generated externals"
+    >:: test_generated_externals;
+  ]
+
+
+let _ =
+  run_test_tt_main suite
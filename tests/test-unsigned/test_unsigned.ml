@@ -0,0 +1,132 @@
+(*
+ * Copyright (c) 2014 Jeremy Yallop.
+ *
+ * This file is distributed under the terms of the MIT License.
+ * See the file LICENSE for details.
+ *)
+
+open OUnit
+open Ctypes
+open Unsigned
+
+
+(*
+  Test that arithmetic on the small unsigned types wraps around as in C.
+*)
+let test_wraparound () = begin
+  UInt8.(begin
+    assert_equal 255 (to_int max_int);
+    assert_equal 0 (to_int (add max_int one));
+    assert_equal 255 (to_int (sub zero one));
+    assert_equal 44 (to_int (mul (of_int 100) (of_int 3)));
+    assert_equal 0xf0 (to_int (shift_left (of_int 0xff) 4));
+    assert_equal 0x0f (to_int (shift_right (of_int 0xff) 4));
+    assert_equal 0 (to_int (lognot max_int));
+    assert_equal 255 (to_int (of_int (-1)));
+    assert_equal 44 (to_int (of_int 300));
+  end);
+
+  UInt16.(begin
+    assert_equal 65535 (to_int max_int);
+    assert_equal 0 (to_int (succ max_int));
+    assert_equal 65535 (to_int (pred zero));
+    assert_equal 7 (to_int (div (of_int 65535) (of_int 9362)));
+    assert_equal 1 (to_int (rem (of_int 65535) (of_int 9362)));
+    assert_raises Division_by_zero (fun () -> div one zero);
+  end);
+
+  UInt32.(begin
+    assert_equal "4294967295" (to_string max_int);
+    assert_equal zero (add max_int one);
+    assert_equal max_int (sub zero one);
+    assert_equal (of_string "4294967294") (mul max_int (of_int 2));
+    assert_equal (-1l) (to_int32 max_int);
+    assert_equal max_int (of_int32 (-1l));
+    assert_bool "comparison is unsigned"
+      (compare (of_string "4294967295") (of_string "1") > 0);
+  end);
+end
+
+
+(*
+  Test that small unsigned values read from and written to C memory have
+  the same values as values constructed in OCaml.
+*)
+let test_memory_round_trip () = begin
+  let p8 = allocate uint8_t (UInt8.of_int 200)
+  and p16 = allocate uint16_t (UInt16.of_int 60000)
+  and p32 = allocate uint32_t (UInt32.of_string "4000000000") in
+  assert_equal (UInt8.of_int 200) (!@ p8);
+  assert_equal (UInt16.of_int 60000) (!@ p16);
+  assert_equal (UInt32.of_string "4000000000") (!@ p32);
+  assert_equal (UInt8.of_int 201) (UInt8.succ (!@ p8));
+  assert_equal 0 (UInt8.compare (UInt8.of_int 200) (!@ p8));
+
+  let arr = CArray.of_list uint8_t (List.map UInt8.of_int [1; 2; 255]) in
+  assert_equal [1; 2; 255] (List.map UInt8.to_int (CArray.to_list arr));
+end
+
+
+(*
+  Test the element-wise operations on arrays of uint64_t values against the
+  corresponding scalar operations.
+*)
+let test_uint64_arrays () = begin
+  let module A = UInt64_array in
+  let values = List.map UInt64.of_string
+      ["0"; "1"; "18446744073709551615"; "9223372036854775808"; "12345"] in
+  let rotated = List.tl values @ [List.hd values] in
+  let a = CArray.of_list uint64_t values
+  and b = CArray.of_list uint64_t rotated
+  and dst = CArray.make uint64_t (List.length values) in
+  let check op scalar =
+    op ~dst a b;
+    assert_equal (List.map2 scalar values rotated) (CArray.to_list dst) in
+  let mask p x y = if p x y then UInt64.max_int else UInt64.zero in
+  check A.add UInt64.add;
+  check A.sub UInt64.sub;
+  check A.mul UInt64.mul;
+  check A.logand UInt64.logand;
+  check A.logor UInt64.logor;
+  check A.logxor UInt64.logxor;
+  check A.equal_mask (mask (fun x y -> UInt64.compare x y = 0));
+  check A.less_mask (mask (fun x y -> UInt64.compare x y < 0));
+
+  A.shift_left ~dst a 3;
+  assert_equal (List.map (fun x -> UInt64.shift_left x 3) values)
+    (CArray.to_list dst);
+  A.shift_right ~dst a 63;
+  assert_equal (List.map (fun x -> UInt64.shift_right x 63) values)
+    (CArray.to_list dst);
+
+  (* The destination may be one of the operands. *)
+  A.add ~dst:a a a;
+  assert_equal (List.map (fun x -> UInt64.add x x) values) (CArray.to_list a);
+
+  assert_raises (Invalid_argument "Ctypes.UInt64_array.add")
+    (fun () -> A.add ~dst a (CArray.make uint64_t 1));
+  assert_raises (Invalid_argument "Ctypes.UInt64_array.shift_left")
+    (fun () -> A.shift_left ~dst a 64);
+
+  let ba = Bigarray.(Array1.of_array int64 c_layout [| 1L; -1L |]) in
+  let c = A.of_bigarray ba in
+  A.add ~dst:c c c;
+  assert_equal [| 2L; -2L |] [| ba.{0}; ba.{1} |];
+  assert_equal (UInt64.of_string "18446744073709551614") (CArray.get c 1);
+end
+
+
+let suite = "Unsigned integer tests" >:::
+  ["wraparound"
+    >:: test_wraparound;
+
+   "memory round trip"
+    >:: test_memory_round_trip;
+
+   "uint64 arrays"
+    >:: test_uint64_arrays;
+  ]
+
+
+let _ =
+  run_test_tt_main suite
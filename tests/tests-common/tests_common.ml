@@ -10,22 +10,33 @@
 open Ctypes
 
 let filenames argv =
-  let usage = "arguments: [--ml-file $filename] [--c-file $filename]"    in
+  let usage = "arguments: [--ml-file $filename] [--c-file $filename] \
+               [--c-struct-file $filename]" in
   let ml_filename = ref ""
-  and c_filename = ref "" in
+  and c_filename = ref ""
+  and c_struct_filename = ref "" in
   let spec = Arg.([ ("--ml-file", Set_string ml_filename, "ML filename");
-                    ("--c-file", Set_string c_filename, "C filename"); ]) in
+                    ("--c-file", Set_string c_filename, "C filename");
+                    ("--c-struct-file", Set_string c_struct_filename,
+                     "C struct filename"); ]) in
   let no_positional_args _ =
     prerr_endline "No positional arguments" in
   begin
     Arg.parse spec no_positional_args usage;
-    (!ml_filename, !c_filename)
+    (!ml_filename, !c_filename, !c_struct_filename)
   end
 
-module Foreign_binder : Cstubs.FOREIGN with type 'a fn = 'a =
+module Foreign_binder : Cstubs.FOREIGN_EXT with type 'a fn = 'a =
 struct
   type 'a fn = 'a
   let foreign name fn = Foreign.foreign name fn
+  let foreign_ext ?noalloc:_ ?release_runtime_lock:_ name fn =
+    Foreign.foreign name fn
+  let foreign_batch ?release_runtime_lock:_ name b =
+    Cstubs.batched b (Foreign.foreign name (Cstubs.batch_fn b))
+  let foreign_into name i =
+    Cstubs.storing i (Foreign.foreign name (Cstubs.into_fn i))
+  let funptr fn = Foreign.funptr fn
 end
 
 module type STUBS = functor  (F : Cstubs.FOREIGN) -> sig end
@@ -47,13 +58,28 @@ let header = "\
 #include \"cstubs/cstubs_internals.h\"
 "
 
-let run ?(cheader="") argv specs =
-  let ml_filename, c_filename = filenames argv in
+let prefix = "cstubs_tests"
+
+let run ?(cheader="") ?inverted ?structs argv specs =
+  let ml_filename, c_filename, c_struct_filename = filenames argv in
   if ml_filename <> "" then
     with_open_formatter ml_filename
-      (fun fmt -> Cstubs.write_ml fmt ~prefix:"cstubs_tests" specs);
+      (fun fmt -> Cstubs.write_ml fmt ~prefix specs);
   if c_filename <> "" then
     with_open_formatter c_filename
       (fun fmt -> 
         Format.fprintf fmt "%s\n%s\n" header cheader;
-        Cstubs.write_c fmt ~prefix:"cstubs_tests" specs)
+        (* The exported functions are defined before the stubs that call
+           them. *)
+        begin match inverted with
+        | None -> ()
+        | Some inverted -> Cstubs_inverted.write_c fmt ~prefix inverted
+        end;
+        Cstubs.write_c fmt ~prefix specs);
+  match structs, c_struct_filename with
+  | Some structs, filename when filename <> "" ->
+    with_open_formatter filename
+      (fun fmt ->
+        Format.fprintf fmt "%s\n%s\n" header cheader;
+        Cstubs_structs.write_c fmt structs)
+  | _ -> ()